@@ -0,0 +1,940 @@
+// Throughput benchmarks for the Chip8 core.
+//
+// Build:
+//     g++ -std=c++20 -O2 -pthread -I../Project1 Chip8Bench.cpp ../Project1/Chip8.cpp ../Project1/Chip8Batch.cpp ../Project1/Chip8Fork.cpp ../Project1/Chip8Pool.cpp ../Project1/FrameRecorder.cpp ../Project1/FusionPlan.cpp ../Project1/PackedFrame.cpp ../Project1/RomAnalyzer.cpp ../Project1/RomDatabase.cpp ../Project1/RunAhead.cpp ../Project1/SessionScheduler.cpp ../Project1/SharedFrameChannel.cpp -o Chip8Bench
+//     (or add both files to an empty console project in Visual Studio, Release|x64, C++20)
+//
+// The checks (state matches, leaves match, scheduler) are worth running under the sanitizers too, with
+// -g -O1 -fsanitize=thread or -fsanitize=address,undefined in place of -O2.
+
+#include "Chip8.h"
+#include "Chip8Batch.h"
+#include "Chip8Fork.h"
+#include "Chip8Pool.h"
+#include "FrameRecorder.h"
+#include "FusionPlan.h"
+#include "RomAnalyzer.h"
+#include "RunAhead.h"
+#include "SessionScheduler.h"
+#include "SharedFrameChannel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+
+const static unsigned int BENCH_CYCLES = 20000000;
+const static unsigned int BENCH_RUNS = 5;
+const static unsigned int BENCH_SESSIONS = 10000;
+const static unsigned int BENCH_CYCLES_PER_SLICE = 12;      // Roughly what one machine runs per frame at 700 Hz
+const static unsigned int BENCH_BATCH_MACHINES = 1024;     // Machines stepped together through the C interface
+const static unsigned int BENCH_TREE_DEPTH = 3;             // Search tree for the fork benchmark, 16 children per node
+const static unsigned int BENCH_HANDOFFS = 2000;            // Frames sent through the shared-memory channel
+
+
+// Loop that hits every handler with a hardened variant: DRW, BCD, register store/load, SKP, CALL and RET.
+// Everything stays in bounds so the unchecked handlers can run it too.
+static const uint8_t MEMORY_LOOP_ROM[] =
+{
+    0xA3, 0x00,     // 0x200  LD I, 0x300
+    0xD0, 0x15,     // 0x202  DRW V0, V1, 5
+    0xF2, 0x33,     // 0x204  LD B, V2
+    0xF2, 0x55,     // 0x206  LD [I], V2
+    0xF2, 0x65,     // 0x208  LD V2, [I]
+    0x22, 0x10,     // 0x20A  CALL 0x210
+    0x72, 0x01,     // 0x20C  ADD V2, 1
+    0x12, 0x02,     // 0x20E  JP 0x202
+    0x74, 0x01,     // 0x210  ADD V4, 1
+    0xE3, 0x9E,     // 0x212  SKP V3
+    0x00, 0xEE,     // 0x214  RET
+    0x00, 0xEE,     // 0x216  RET
+};
+
+
+// Tight RND loop
+static const uint8_t RANDOM_LOOP_ROM[] =
+{
+    0xC0, 0xFF,     // 0x200  RND V0, 0xFF
+    0xC1, 0x0F,     // 0x202  RND V1, 0x0F
+    0x12, 0x00,     // 0x204  JP 0x200
+};
+
+
+// Game-shaped loop with one of each fusable sequence
+static const uint8_t FUSION_LOOP_ROM[] =
+{
+    0x6A, 0x00,     // 0x200  LD VA, 0
+    0xA2, 0x20,     // 0x202  LD I, 0x220       } IndexDraw
+    0xDA, 0xB5,     // 0x204  DRW VA, VB, 5     }
+    0x7A, 0x01,     // 0x206  ADD VA, 1         } CountLoop
+    0x3A, 0x20,     // 0x208  SE VA, 0x20       }
+    0x12, 0x02,     // 0x20A  JP 0x202          }
+    0x60, 0x03,     // 0x20C  LD V0, 3          } LoadDelay
+    0xF0, 0x15,     // 0x20E  LD DT, V0         }
+    0xF1, 0x07,     // 0x210  LD V1, DT
+    0x31, 0x00,     // 0x212  SE V1, 0          } SkipJump
+    0x12, 0x10,     // 0x214  JP 0x210          }
+    0x00, 0xE0,     // 0x216  CLS
+    0x12, 0x00,     // 0x218  JP 0x200
+    0x00, 0x00,     // 0x21A
+    0x00, 0x00,     // 0x21C
+    0x00, 0x00,     // 0x21E
+    0xF0, 0x90, 0xF0, 0x90, 0xF0,   // 0x220  sprite
+};
+
+
+// Best-of-N cycles per second, the best run is the one least disturbed by the rest of the system
+template <typename Setup>
+static double MeasureCyclesPerSecond(Setup setup)
+{
+    double best = 0.0;
+
+    for (unsigned int run = 0; run < BENCH_RUNS; ++run)
+    {
+        Chip8 chip8;
+        setup(chip8);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (unsigned int i = 0; i < BENCH_CYCLES; ++i)
+        {
+            chip8.Cycle();
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+
+        best = std::max(best, BENCH_CYCLES / seconds);
+    }
+
+    return best;
+}
+
+
+static void BenchHardened()
+{
+    double unchecked = MeasureCyclesPerSecond([](Chip8& chip8)
+    {
+        chip8.LoadROM(MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+    });
+
+    double hardened = MeasureCyclesPerSecond([](Chip8& chip8)
+    {
+        chip8.SetHardened(true);
+        chip8.LoadROM(MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+    });
+
+    printf("hardened:   unchecked %8.1f Mcycles/s   hardened %8.1f Mcycles/s   (%+.1f%%)\n",
+        unchecked / 1e6, hardened / 1e6, (hardened / unchecked - 1.0) * 100.0);
+}
+
+
+// RND throughput, the generator on its own against the std::mt19937 + uniform_int_distribution it replaced, and
+// a check that seed 1 still gives the top bytes of Marsaglia's xorshift32 sequence (270369, 67634689, ...)
+static void BenchRandom()
+{
+    static const uint8_t golden[16] =
+    {
+        0x00, 0x04, 0x9D, 0x12, 0x8E, 0x2C, 0x25, 0x19, 0x77, 0xAD, 0x9E, 0x59, 0xB4, 0x04, 0x05, 0xC9
+    };
+
+    Chip8 seeded;
+    seeded.Seed(1);
+
+    bool matches = true;
+
+    for (uint8_t expected : golden)
+    {
+        matches = matches && seeded.NextRandomByte() == expected;
+    }
+
+    double rnd = MeasureCyclesPerSecond([](Chip8& chip8)
+    {
+        chip8.Seed(1);
+        chip8.LoadROM(RANDOM_LOOP_ROM, sizeof(RANDOM_LOOP_ROM));
+    });
+
+    // Bytes per second from each generator, summed into a volatile so the loops can't be dropped
+    static volatile unsigned int sink;
+    unsigned int sum = 0;
+    double xorshift = 0.0;
+    double twister = 0.0;
+
+    for (unsigned int run = 0; run < BENCH_RUNS; ++run)
+    {
+        Chip8 chip8;
+        chip8.Seed(1);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (unsigned int i = 0; i < BENCH_CYCLES; ++i)
+        {
+            sum += chip8.NextRandomByte();
+        }
+
+        auto middle = std::chrono::high_resolution_clock::now();
+
+        std::mt19937 engine(1);
+        std::uniform_int_distribution<int> byte(0, 255);
+
+        for (unsigned int i = 0; i < BENCH_CYCLES; ++i)
+        {
+            sum += static_cast<uint8_t>(byte(engine));
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        xorshift = std::max(xorshift, BENCH_CYCLES / std::chrono::duration<double>(middle - start).count());
+        twister = std::max(twister, BENCH_CYCLES / std::chrono::duration<double>(end - middle).count());
+    }
+
+    sink = sum;
+
+    printf("random:     %8.1f Mcycles/s   bytes: xorshift32 %7.1f M/s   mt19937 %7.1f M/s   seed 1 %s\n",
+        rnd / 1e6, xorshift / 1e6, twister / 1e6, matches ? "matches" : "DIFFERS");
+}
+
+
+// Same frames with and without the fusion plan: dispatches per frame, throughput, and a check that both
+// machines agree at every frame boundary
+static void BenchFusion()
+{
+    Chip8 plain;
+    plain.Seed(1);
+    plain.LoadROM(FUSION_LOOP_ROM, sizeof(FUSION_LOOP_ROM));
+
+    Chip8 fused;
+    fused.Seed(1);
+    fused.LoadROM(FUSION_LOOP_ROM, sizeof(FUSION_LOOP_ROM));
+
+    static FusionPlan plan;
+    bool built = plan.Build(fused, RomAnalyzer::Analyze(fused));
+    fused.SetFusion(&plan);
+
+    unsigned int frames = BENCH_CYCLES / BENCH_CYCLES_PER_SLICE;
+    unsigned long long dispatches = 0;
+    bool matches = built;
+
+    for (unsigned int frame = 0; frame < 10000 && matches; ++frame)
+    {
+        plain.Run(BENCH_CYCLES_PER_SLICE);
+        dispatches += fused.Run(BENCH_CYCLES_PER_SLICE);
+
+        matches = plain.pc == fused.pc && plain.index == fused.index && plain.sp == fused.sp &&
+            plain.delayTimer == fused.delayTimer && plain.soundTimer == fused.soundTimer &&
+            memcmp(plain.registers, fused.registers, sizeof(plain.registers)) == 0 &&
+            memcmp(plain.video, fused.video, sizeof(plain.video)) == 0 &&
+            memcmp(plain.memory, fused.memory, sizeof(plain.memory)) == 0;
+    }
+
+    double withoutPlan = MeasureCyclesPerSecond([](Chip8& chip8)
+    {
+        chip8.LoadROM(FUSION_LOOP_ROM, sizeof(FUSION_LOOP_ROM));
+    });
+
+    double best = 0.0;
+
+    for (unsigned int run = 0; run < BENCH_RUNS; ++run)
+    {
+        Chip8 chip8;
+        chip8.LoadROM(FUSION_LOOP_ROM, sizeof(FUSION_LOOP_ROM));
+        chip8.SetFusion(&plan);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (unsigned int frame = 0; frame < frames; ++frame)
+        {
+            chip8.Run(BENCH_CYCLES_PER_SLICE);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        best = std::max(best, frames * BENCH_CYCLES_PER_SLICE / std::chrono::duration<double>(end - start).count());
+    }
+
+    printf("fusion:     %zu sequences   %u -> %.2f dispatches/frame   %8.1f -> %8.1f Mcycles/s   state %s\n",
+        plan.Count(), BENCH_CYCLES_PER_SLICE, dispatches / 10000.0, withoutPlan / 1e6, best / 1e6,
+        matches ? "matches" : "DIFFERS");
+}
+
+
+// Run-ahead overhead: snapshot cost against the cost of the frame it speculates
+static void BenchRunAhead()
+{
+    static Chip8 chip8;
+    chip8.LoadROM(FUSION_LOOP_ROM, sizeof(FUSION_LOOP_ROM));
+
+    static RunAhead runAhead(2);
+    RunAheadStats total{};
+    const unsigned int frames = 100000;
+
+    for (unsigned int frame = 0; frame < frames; ++frame)
+    {
+        runAhead.RunFrame(chip8);
+
+        RunAheadStats const& stats = runAhead.LastFrameStats();
+        total.emulateMicros += stats.emulateMicros;
+        total.snapshotMicros += stats.snapshotMicros;
+        total.speculateMicros += stats.speculateMicros;
+    }
+
+    printf("run-ahead:  2 frames   per frame %.3f us emulate + %.3f us snapshot + %.3f us run-ahead\n",
+        total.emulateMicros / frames, total.snapshotMicros / frames, total.speculateMicros / frames);
+}
+
+
+
+
+// Emulator to frontend latency through SharedFrameChannel. One thread publishes the frames of a running
+// machine, another attaches by name (its own mapping, like a frontend process) and spins for them. Frames go
+// out 1 ms apart instead of 16 to keep the run short, the reader is waiting for each one either way.
+static void BenchChannel()
+{
+    typedef SharedFrameChannel::Clock Clock;
+
+    SharedFrameChannel emulator("/chip8-bench", true);
+    SharedFrameChannel frontend("/chip8-bench", false);
+
+    if (emulator.NameInUse())
+    {
+        printf("channel:    /chip8-bench is in use, or left over from a crashed run\n");
+        return;
+    }
+
+    if (!emulator.IsOpen() || !frontend.IsOpen())
+    {
+        printf("channel:    shared memory not available\n");
+        return;
+    }
+
+    std::vector<double> handoffs;
+    handoffs.reserve(BENCH_HANDOFFS);
+
+    std::thread reader([&]()
+    {
+        PackedFrame frame;
+        uint32_t sequence = 0;
+
+        while (handoffs.size() < BENCH_HANDOFFS)
+        {
+            Clock::time_point publishedAt;
+            uint32_t latest = frontend.WaitForFrame(frame, sequence, std::chrono::seconds(1), &publishedAt);
+
+            if (latest == sequence)
+            {
+                break;
+            }
+
+            handoffs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - publishedAt).count());
+            sequence = latest;
+        }
+    });
+
+    Chip8 chip8;
+    chip8.LoadROM(FUSION_LOOP_ROM, sizeof(FUSION_LOOP_ROM));
+
+    double publishMicros = 0.0;
+
+    for (unsigned int i = 0; i < BENCH_HANDOFFS; ++i)
+    {
+        chip8.Run(BENCH_CYCLES_PER_SLICE);
+
+        auto start = Clock::now();
+        emulator.PublishFrame(chip8);
+        publishMicros += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    reader.join();
+
+    if (handoffs.empty())
+    {
+        printf("channel:    no frames received\n");
+        return;
+    }
+
+    std::sort(handoffs.begin(), handoffs.end());
+
+    printf("channel:    %zu/%u frames   publish %5.2f us   handoff p50 %6.2f us   p99 %6.2f us   max %7.2f us\n",
+        handoffs.size(), BENCH_HANDOFFS, publishMicros / BENCH_HANDOFFS, handoffs[handoffs.size() / 2],
+        handoffs[handoffs.size() * 99 / 100], handoffs.back());
+}
+
+
+// Steps a batch on all threads next to machines stepped directly, with the keys changing every step, and counts
+// the machine-steps whose frame or reward differs. Every third step asks for nothing and every fifth for rewards
+// only, so the packed frames also have to catch up on rows drawn during steps that weren't packed.
+static unsigned int CheckBatch(unsigned int steps)
+{
+    std::vector<Chip8> machines(BENCH_BATCH_MACHINES);
+    static FusionPlan plan;
+
+    for (unsigned int i = 0; i < BENCH_BATCH_MACHINES; ++i)
+    {
+        Chip8& chip8 = machines[i];
+
+        chip8.Seed(i);
+        chip8.LoadROM(MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+
+        if (i == 0 && !plan.Build(chip8, RomAnalyzer::Analyze(chip8)))
+        {
+            plan = FusionPlan();
+        }
+
+        chip8.SetFusion(&plan);
+    }
+
+    Chip8Batch* batch = chip8_batch_create(BENCH_BATCH_MACHINES, 0);
+    chip8_batch_load_rom(batch, MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+    chip8_batch_set_reward(batch, CHIP8_REWARD_REGISTER, 0x2);
+
+    std::vector<uint16_t> keys(BENCH_BATCH_MACHINES);
+    std::vector<uint64_t> framesOut(BENCH_BATCH_MACHINES * CHIP8_FRAME_ROWS);
+    std::vector<int32_t> rewards(BENCH_BATCH_MACHINES);
+    std::vector<uint32_t> pixels(Chip8::VIDEO_WIDTH * Chip8::VIDEO_HEIGHT);
+    unsigned int mismatches = 0;
+
+    for (unsigned int step = 0; step < steps; ++step)
+    {
+        bool wantRewards = step % 3 != 0;
+        bool wantFrames = wantRewards && step % 5 != 0;
+
+        for (unsigned int i = 0; i < BENCH_BATCH_MACHINES; ++i)
+        {
+            keys[i] = static_cast<uint16_t>(1u << ((i + step) & 0xFu));
+        }
+
+        chip8_batch_step(batch, keys.data(), 1, wantFrames ? framesOut.data() : nullptr,
+            wantRewards ? rewards.data() : nullptr);
+
+        for (unsigned int i = 0; i < BENCH_BATCH_MACHINES; ++i)
+        {
+            Chip8& chip8 = machines[i];
+
+            for (unsigned int key = 0; key < 16; ++key)
+            {
+                chip8.keypad[key] = (keys[i] >> key) & 1u;
+            }
+
+            int32_t before = chip8.registers[2];
+            chip8.RunFrame();
+
+            bool matches = !wantRewards || rewards[i] == chip8.registers[2] - before;
+
+            if (wantFrames)
+            {
+                PackedFrame frame;
+                memcpy(frame.rows, &framesOut[i * CHIP8_FRAME_ROWS], sizeof(frame.rows));
+                frame.Unpack(pixels.data());
+
+                matches = matches && memcmp(pixels.data(), chip8.video, sizeof(chip8.video)) == 0;
+            }
+
+            mismatches += matches ? 0 : 1;
+        }
+    }
+
+    chip8_batch_destroy(batch);
+
+    return mismatches;
+}
+
+
+// Cost of one machine-frame when stepping the machines directly vs through the batched C interface, on one
+// thread and on all of them. The direct machines are set up the way the batch sets its own up (seed + i, the
+// shared fusion plan) and hold the same keys, so the difference is the interface itself, plus packing frames
+// and computing rewards when those are asked for.
+static void BenchBatch()
+{
+    unsigned int frames = BENCH_CYCLES / (BENCH_BATCH_MACHINES * BENCH_CYCLES_PER_SLICE);
+
+    std::vector<uint16_t> keys(BENCH_BATCH_MACHINES);
+
+    for (unsigned int i = 0; i < BENCH_BATCH_MACHINES; ++i)
+    {
+        keys[i] = static_cast<uint16_t>(1u << (i & 0xFu));
+    }
+
+    std::vector<Chip8> machines(BENCH_BATCH_MACHINES);
+    static FusionPlan plan;
+
+    for (unsigned int i = 0; i < BENCH_BATCH_MACHINES; ++i)
+    {
+        Chip8& chip8 = machines[i];
+
+        chip8.Seed(i);
+        chip8.LoadROM(MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+
+        if (i == 0 && !plan.Build(chip8, RomAnalyzer::Analyze(chip8)))
+        {
+            plan = FusionPlan();
+        }
+
+        chip8.SetFusion(&plan);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int frame = 0; frame < frames; ++frame)
+    {
+        for (unsigned int i = 0; i < BENCH_BATCH_MACHINES; ++i)
+        {
+            Chip8& chip8 = machines[i];
+
+            for (unsigned int key = 0; key < 16; ++key)
+            {
+                chip8.keypad[key] = (keys[i] >> key) & 1u;
+            }
+
+            chip8.RunFrame();
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double direct = std::chrono::duration<double, std::nano>(end - start).count() / (frames * BENCH_BATCH_MACHINES);
+
+    std::vector<uint64_t> framesOut(BENCH_BATCH_MACHINES * CHIP8_FRAME_ROWS);
+    std::vector<int32_t> rewards(BENCH_BATCH_MACHINES);
+
+    // Stepping only, then with frames and rewards, on one thread; with frames and rewards on all of them
+    double batched[3] = {};
+    static const uint32_t threadCounts[3] = { 1, 1, 0 };
+
+    for (unsigned int run = 0; run < 3; ++run)
+    {
+        bool outputs = run > 0;
+
+        Chip8Batch* batch = chip8_batch_create(BENCH_BATCH_MACHINES, threadCounts[run]);
+        chip8_batch_load_rom(batch, MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+        chip8_batch_set_reward(batch, CHIP8_REWARD_REGISTER, 0x2);
+
+        start = std::chrono::high_resolution_clock::now();
+
+        for (unsigned int frame = 0; frame < frames; ++frame)
+        {
+            chip8_batch_step(batch, keys.data(), 1, outputs ? framesOut.data() : nullptr, outputs ? rewards.data() : nullptr);
+        }
+
+        end = std::chrono::high_resolution_clock::now();
+        batched[run] = std::chrono::duration<double, std::nano>(end - start).count() / (frames * BENCH_BATCH_MACHINES);
+
+        chip8_batch_destroy(batch);
+    }
+
+    unsigned int mismatches = CheckBatch(600);
+
+    printf("batch:      %u machines   direct %6.1f ns   C API step %6.1f ns   + frames/rewards %6.1f ns   all threads %6.1f ns   per machine-frame   ",
+        BENCH_BATCH_MACHINES, direct, batched[0], batched[1], batched[2]);
+
+    if (mismatches == 0)
+    {
+        printf("frames/rewards match\n");
+    }
+    else
+    {
+        printf("%u machine-steps DIFFER\n", mismatches);
+    }
+}
+
+
+// Expands a search tree (one child per key, one frame per node) by copying whole machines and by forking,
+// and checks both trees end up with the same leaves
+static void BenchFork()
+{
+    Chip8 root;
+    root.LoadROM(MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<Chip8> copies = { root };
+    size_t nodes = 0;
+
+    for (unsigned int depth = 0; depth < BENCH_TREE_DEPTH; ++depth)
+    {
+        std::vector<Chip8> next;
+        next.reserve(copies.size() * 16);
+
+        for (Chip8 const& parent : copies)
+        {
+            for (unsigned int key = 0; key < 16; ++key)
+            {
+                next.push_back(parent);
+                next.back().keypad[key] = 1;
+                next.back().Run(BENCH_CYCLES_PER_SLICE);
+            }
+        }
+
+        nodes += next.size();
+        copies = std::move(next);
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    ForkRunner runner;
+    runner.chip8 = root;
+
+    std::vector<Chip8Fork> forks = { runner.Capture() };
+
+    for (unsigned int depth = 0; depth < BENCH_TREE_DEPTH; ++depth)
+    {
+        std::vector<Chip8Fork> next;
+        next.reserve(forks.size() * 16);
+
+        for (Chip8Fork const& parent : forks)
+        {
+            for (unsigned int key = 0; key < 16; ++key)
+            {
+                runner.Load(parent);
+                runner.chip8.keypad[key] = 1;
+                runner.chip8.Run(BENCH_CYCLES_PER_SLICE);
+                next.push_back(runner.Capture());
+            }
+        }
+
+        forks = std::move(next);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    bool same = copies.size() == forks.size();
+    static uint32_t video[Chip8::VIDEO_WIDTH * Chip8::VIDEO_HEIGHT];
+    ForkRunner restored;
+
+    for (size_t i = 0; same && i < copies.size(); ++i)
+    {
+        forks[i].Video(video);
+        restored.Load(forks[i]);
+
+        same = copies[i].pc == restored.chip8.pc && copies[i].sp == restored.chip8.sp &&
+            memcmp(copies[i].registers, restored.chip8.registers, sizeof(copies[i].registers)) == 0 &&
+            memcmp(copies[i].stack, restored.chip8.stack, sizeof(copies[i].stack)) == 0 &&
+            memcmp(copies[i].video, video, sizeof(copies[i].video)) == 0;
+
+        for (unsigned int address = 0; same && address < sizeof(copies[i].memory); ++address)
+        {
+            same = copies[i].memory[address] == forks[i].ReadByte(static_cast<uint16_t>(address));
+        }
+    }
+
+    double copySeconds = std::chrono::duration<double>(middle - start).count();
+    double forkSeconds = std::chrono::duration<double>(end - middle).count();
+
+    printf("fork:       %zu nodes   copy %8.0f nodes/s   fork %8.0f nodes/s   %.2f pages/node   %s\n",
+        nodes, nodes / copySeconds, nodes / forkSeconds, double(runner.PagesAllocated()) / nodes,
+        same ? "leaves match" : "LEAVES DIFFER");
+}
+
+
+
+// Cost of recording a minute of frames on the emulator thread, and how big the recording ends up
+static void BenchCapture()
+{
+    const unsigned int frames = 60 * 60;
+    char const* filename = "Chip8Bench.c8v";
+
+    Chip8 chip8;
+    chip8.LoadROM(FUSION_LOOP_ROM, sizeof(FUSION_LOOP_ROM));
+
+    double recordMicros = 0.0;
+    uint64_t bytes = 0;
+
+    {
+        FrameRecorder recorder(filename);
+
+        for (unsigned int frame = 0; frame < frames; ++frame)
+        {
+            chip8.RunFrame();
+
+            auto start = std::chrono::high_resolution_clock::now();
+            recorder.Record(chip8);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            recordMicros += std::chrono::duration<double, std::micro>(end - start).count();
+        }
+
+        bytes = recorder.Bytes();
+    }
+
+    std::remove(filename);
+
+    printf("capture:    %.2f us/frame   %.1f KB/minute (raw video %.0f KB/minute)\n",
+        recordMicros / frames, bytes / 1024.0, frames * sizeof(chip8.video) / 1024.0);
+}
+
+
+// Time to start (and end) a session: a fresh heap allocated machine vs one recycled from the pool
+static void BenchSessionStart()
+{
+    static Chip8* sessions[BENCH_SESSIONS];
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int i = 0; i < BENCH_SESSIONS; ++i)
+    {
+        sessions[i] = new Chip8();
+    }
+    for (unsigned int i = 0; i < BENCH_SESSIONS; ++i)
+    {
+        delete sessions[i];
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    Chip8Pool pool;
+    pool.Reserve(BENCH_SESSIONS);
+
+    auto poolStart = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int i = 0; i < BENCH_SESSIONS; ++i)
+    {
+        sessions[i] = pool.Acquire();
+    }
+    for (unsigned int i = 0; i < BENCH_SESSIONS; ++i)
+    {
+        pool.Release(sessions[i]);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double fresh = std::chrono::duration<double, std::micro>(middle - start).count() / BENCH_SESSIONS;
+    double pooled = std::chrono::duration<double, std::micro>(end - poolStart).count() / BENCH_SESSIONS;
+
+    printf("sessions:   sizeof(Chip8) %zu bytes   new/delete %6.2f us   pool %6.2f us\n", sizeof(Chip8), fresh, pooled);
+}
+
+// Sessions on the scheduler: removed at random points while they run (and freed straight away), parked on
+// Fx0A until a key is held, and parked on the delay timer instead of spinning on it
+static void BenchScheduler()
+{
+    static const uint8_t BUSY_ROM[] = { 0x71, 0x01, 0x12, 0x00 };                      // ADD V1, 1 / JP 0x200
+    static const uint8_t KEY_ROM[] = { 0xF0, 0x0A, 0x71, 0x01, 0x12, 0x00 };           // LD V0, K / ADD V1, 1 / JP
+    static const uint8_t DELAY_ROM[] = { 0x60, 0x3C, 0xF0, 0x15, 0xF1, 0x07,           // 1 second wait, then V2 + 1
+        0x31, 0x00, 0x12, 0x04, 0x72, 0x01, 0x12, 0x00 };
+
+    const unsigned int SESSIONS = 64;
+
+    SessionScheduler scheduler(4);
+    unsigned int failures = 0;
+
+    // Removed after 0 - 500 us, usually in the middle of a frame
+    for (unsigned int i = 0; i < SESSIONS * 4; ++i)
+    {
+        Chip8* chip8 = new Chip8();
+        chip8->LoadROM(BUSY_ROM, sizeof(BUSY_ROM));
+
+        SessionScheduler::SessionId id = scheduler.Add(chip8);
+        std::this_thread::sleep_for(std::chrono::microseconds((i * 37) % 500));
+        scheduler.Remove(id);
+
+        delete chip8;
+    }
+
+    failures += (scheduler.Count() != 0);
+
+    std::vector<Chip8> keyMachines(SESSIONS);
+    std::vector<Chip8> delayMachines(SESSIONS);
+    std::vector<SessionScheduler::SessionId> keyIds;
+    std::vector<SessionScheduler::SessionId> delayIds;
+
+    for (unsigned int i = 0; i < SESSIONS; ++i)
+    {
+        keyMachines[i].LoadROM(KEY_ROM, sizeof(KEY_ROM));
+        delayMachines[i].LoadROM(DELAY_ROM, sizeof(DELAY_ROM));
+
+        keyIds.push_back(scheduler.Add(&keyMachines[i]));
+        delayIds.push_back(scheduler.Add(&delayMachines[i]));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // About 12 frames have gone by, a parked session ran one or two of them
+    unsigned int keyParked = 0;
+    unsigned int delayParked = 0;
+    uint64_t emulated = 0;
+    uint64_t skipped = 0;
+
+    for (unsigned int i = 0; i < SESSIONS; ++i)
+    {
+        SessionStats keyStats = scheduler.Stats(keyIds[i]);
+        SessionStats delayStats = scheduler.Stats(delayIds[i]);
+
+        keyParked += keyStats.keyWaits > 0 && keyStats.frames <= 2;
+        delayParked += delayStats.delayWaits > 0 && delayStats.frames <= 2;
+        emulated += keyStats.frames + delayStats.frames;
+        skipped += delayStats.framesSkipped;
+
+        scheduler.SetKeys(keyIds[i], 0x0001);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    unsigned int keyWoken = 0;
+
+    for (unsigned int i = 0; i < SESSIONS; ++i)
+    {
+        scheduler.Remove(keyIds[i]);
+        scheduler.Remove(delayIds[i]);
+
+        // Safe to look at now the sessions are gone: held keys run the loop, the delay loop is still waiting
+        keyWoken += keyMachines[i].registers[1] > 0;
+        failures += delayMachines[i].registers[2] != 0;
+    }
+
+    failures += (keyParked != SESSIONS) + (delayParked != SESSIONS) + (keyWoken != SESSIONS) + (scheduler.Count() != 0);
+
+    printf("scheduler:  %u removed while running   key waits parked %u/%u woken %u/%u   delay waits parked %u/%u (%llu frames run, %llu skipped)   %s\n",
+        SESSIONS * 4, keyParked, SESSIONS, keyWoken, SESSIONS, delayParked, SESSIONS,
+        static_cast<unsigned long long>(emulated), static_cast<unsigned long long>(skipped), failures == 0 ? "ok" : "FAILED");
+}
+
+
+
+// Chip8's members in the order they had before the cache-line layout (no alignas, hot fields spread over
+// memory, the stack area and the end of video). Only used as the control in BenchInstancesPerCore.
+struct PackedChip8
+{
+    uint8_t registers[16]{};
+    uint8_t memory[4096]{};
+    uint16_t index{};
+    uint16_t pc{};
+    uint16_t stack[16]{};
+    uint8_t sp{};
+    uint8_t delayTimer{};
+    uint8_t soundTimer{};
+    uint8_t keypad[16]{};
+    uint32_t video[64 * 32]{};
+    uint16_t opcode{};
+    uint32_t rngState{};
+    Chip8::DispatchTables const* tables{};
+};
+
+
+// Touches the fields Cycle() and a typical handler touch on every instruction (fetch, decode, a register,
+// the stack, the keypad, the timers), so the two layouts can be compared on exactly the same work
+template <typename Machine>
+static void CycleShaped(Machine& m)
+{
+    m.opcode = static_cast<uint16_t>((m.memory[m.pc] << 8u) | m.memory[m.pc + 1u]);
+    m.pc = static_cast<uint16_t>(m.pc + 2u);
+
+    m.registers[(m.opcode >> 8u) & 0xFu] += static_cast<uint8_t>(m.opcode);
+    m.stack[m.sp & 0xFu] = m.pc;
+    m.index = static_cast<uint16_t>((m.index + m.keypad[m.opcode & 0xFu]) & Chip8::MEMORY_MASK);
+
+    if (m.delayTimer > 0) --m.delayTimer;
+    if (m.soundTimer > 0) --m.soundTimer;
+
+    if (m.pc >= Chip8::START_ADDRESS + sizeof(MEMORY_LOOP_ROM))
+    {
+        m.pc = Chip8::START_ADDRESS;
+    }
+}
+
+
+template <typename Machine>
+static double MeasureCycleShaped(std::vector<Machine>& machines)
+{
+    for (Machine& machine : machines)
+    {
+        memcpy(&machine.memory[Chip8::START_ADDRESS], MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+        machine.pc = Chip8::START_ADDRESS;
+    }
+
+    unsigned int count = static_cast<unsigned int>(machines.size());
+    unsigned int rounds = BENCH_CYCLES / (count * BENCH_CYCLES_PER_SLICE);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int round = 0; round < rounds; ++round)
+    {
+        for (Machine& machine : machines)
+        {
+            for (unsigned int i = 0; i < BENCH_CYCLES_PER_SLICE; ++i)
+            {
+                CycleShaped(machine);
+            }
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    return static_cast<double>(rounds) * count * BENCH_CYCLES_PER_SLICE / seconds;
+}
+
+
+// Many machines round-robin on one core, a few instructions each before moving on (like a session host would).
+// Shows how throughput holds up as the working set outgrows the caches: the real core, then the same
+// per-instruction field accesses on the current layout and on the old packed one (the control).
+static void BenchInstancesPerCore()
+{
+    static const unsigned int instanceCounts[] = { 1, 16, 256, 4096 };
+
+    for (unsigned int count : instanceCounts)
+    {
+        Chip8Pool pool;
+        std::vector<Chip8*> machines(count);
+
+        for (Chip8*& chip8 : machines)
+        {
+            chip8 = pool.Acquire();
+            chip8->LoadROM(MEMORY_LOOP_ROM, sizeof(MEMORY_LOOP_ROM));
+        }
+
+        unsigned int rounds = BENCH_CYCLES / (count * BENCH_CYCLES_PER_SLICE);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (unsigned int round = 0; round < rounds; ++round)
+        {
+            for (Chip8* chip8 : machines)
+            {
+                for (unsigned int i = 0; i < BENCH_CYCLES_PER_SLICE; ++i)
+                {
+                    chip8->Cycle();
+                }
+            }
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double cycles = static_cast<double>(rounds) * count * BENCH_CYCLES_PER_SLICE;
+
+        for (Chip8* chip8 : machines)
+        {
+            pool.Release(chip8);
+        }
+
+        std::vector<Chip8> aligned(count);
+        std::vector<PackedChip8> packed(count);
+
+        double alignedRate = MeasureCycleShaped(aligned);
+        double packedRate = MeasureCycleShaped(packed);
+
+        printf("instances:  %5u machines   %8.1f Mcycles/s   field accesses: aligned %8.1f M/s   packed %8.1f M/s   (%+.1f%%)\n",
+            count, cycles / seconds / 1e6, alignedRate / 1e6, packedRate / 1e6, (alignedRate / packedRate - 1.0) * 100.0);
+    }
+}
+
+
+int main()
+{
+    BenchHardened();
+    BenchRandom();
+    BenchFusion();
+    BenchRunAhead();
+    BenchChannel();
+    BenchFork();
+    BenchBatch();
+    BenchCapture();
+    BenchSessionStart();
+    BenchScheduler();
+    BenchInstancesPerCore();
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+// libFuzzer harness for the hardened Chip8 core. Every input also runs on a second machine with the fusion plan
+// the analyzer builds for it, and the two have to agree after every frame: a plan is only built for ROMs that
+// can't rewrite their code, so any difference is a bug in the analyzer or a fused handler (reported as a crash).
+//
+// Build (clang):
+//     clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -I../Project1 Chip8Fuzz.cpp ../Project1/Chip8.cpp ../Project1/FusionPlan.cpp ../Project1/RomAnalyzer.cpp ../Project1/RomDatabase.cpp -o Chip8Fuzz
+//
+// The first two bytes of the input are the keypad state (one bit per key), the rest is loaded as the ROM.
+
+#include "Chip8.h"
+#include "FusionPlan.h"
+#include "RomAnalyzer.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+// Enough cycles to get through a few frames of real code without making each input slow
+const static unsigned int FUZZ_CYCLES = 20000;
+
+
+static void Setup(Chip8& chip8, uint8_t const* data, size_t size)
+{
+    chip8.SetHardened(true);
+    chip8.Seed(1);      // Crashes have to reproduce from the input alone
+
+    uint16_t keys = (data[0] << 8u) | data[1];
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        chip8.keypad[i] = (keys >> i) & 0x1u;
+    }
+
+    chip8.LoadROM(data + 2, size - 2);
+}
+
+
+// Everything an instruction can change
+static bool SameState(Chip8 const& a, Chip8 const& b)
+{
+    return a.pc == b.pc && a.index == b.index && a.sp == b.sp &&
+        a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer &&
+        memcmp(a.registers, b.registers, sizeof(a.registers)) == 0 &&
+        memcmp(a.stack, b.stack, sizeof(a.stack)) == 0 &&
+        memcmp(a.memory, b.memory, sizeof(a.memory)) == 0 &&
+        memcmp(a.video, b.video, sizeof(a.video)) == 0;
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size)
+{
+    if (size < 2)
+    {
+        return 0;
+    }
+
+    Chip8 plain;
+    Setup(plain, data, size);
+
+    Chip8 fused;
+    Setup(fused, data, size);
+
+    FusionPlan plan;
+
+    if (plan.Build(fused, RomAnalyzer::Analyze(fused)))
+    {
+        fused.SetFusion(&plan);
+    }
+
+    unsigned int frames = FUZZ_CYCLES / plain.profile.cyclesPerFrame;
+
+    for (unsigned int frame = 0; frame < frames; ++frame)
+    {
+        plain.RunFrame();
+        fused.RunFrame();
+
+        if (!SameState(plain, fused))
+        {
+            abort();
+        }
+    }
+
+    return 0;
+}
@@ -1,755 +1,1182 @@
-//#include "Chip8.h"
+#include "Chip8.h"
+#include "FusionPlan.h"
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <fstream>
-#include <random>
 #include <string.h>
+#include <type_traits>
 
-class Chip8
-{
-public:
-    uint8_t registers[16]{};        // Storage V0 - VF (all CPU oprations)
-    uint8_t memory[4096]{};         // 4 bytes (interpreter, characters, intructions)
-    uint16_t index{};               // Memory addresses
-    uint16_t pc{};                  // Address of the next instruction to execute
-    uint16_t stack[16]{};           // Tracks order of execution
-    uint8_t sp{};                   // Tracks top of stack
-    uint8_t delayTimer{};
-    uint8_t soundTimer{};
-    uint8_t keypad[16]{};           // 0 - F input keys
-    uint32_t video[64 * 32]{};      // Pixels
-    uint16_t opcode;
 
+// Keep the layout described in Chip8.h honest
+static_assert(offsetof(Chip8, soundTimer) < Chip8::CACHE_LINE_SIZE, "hot CPU state must fit in the first cache line");
+static_assert(offsetof(Chip8, keypad) + sizeof(Chip8::keypad) <= 2 * Chip8::CACHE_LINE_SIZE, "stack and keypad must fit in the second cache line");
+static_assert(offsetof(Chip8, memory) % Chip8::CACHE_LINE_SIZE == 0, "memory must start on a cache line");
+static_assert(offsetof(Chip8, video) % Chip8::CACHE_LINE_SIZE == 0, "video must start on a cache line");
+static_assert(sizeof(Chip8) % Chip8::CACHE_LINE_SIZE == 0, "machines in an array must not share cache lines");
+static_assert(std::is_trivially_copyable<Chip8>::value, "copying a machine has to be a full snapshot");
 
 
-    const unsigned int START_ADDRESS = 0x200;           // Start address for instructions in memory
-    const unsigned int FONTSET_START_ADDRESS = 0x50;    // Start address for characters in memory
 
-    const unsigned int VIDEO_WIDTH = 64;
-    const unsigned int VIDEO_HEIGHT = 32;
+const uint8_t Chip8::fontset[FONTSET_SIZE] =
+{
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
 
 
 
-    std::default_random_engine randGen;
-    std::uniform_int_distribution<uint8_t> randByte;
+RomDatabase const* Chip8::romDatabase = nullptr;
 
 
 
-    typedef void (Chip8::*Chip8Func)();
-    Chip8Func table[0xF + 1];
-    Chip8Func table0[0xE + 1];
-    Chip8Func table8[0xE + 1];
-    Chip8Func tableE[0xE + 1];
-    Chip8Func tableF[0x65 + 1];
+// Fills in one set of dispatch tables, the hardened set swaps in the masked/clipped handlers
+static Chip8::DispatchTables BuildTables(bool hardened)
+{
+    Chip8::DispatchTables t;
+
+    // Array of function pointers for the first digits ($0 to $F) of the opcode
+    t.table[0x0] = &Chip8::Table0;
+    t.table[0x1] = &Chip8::OP_1nnn;
+    t.table[0x2] = hardened ? &Chip8::OP_2nnn_Hardened : &Chip8::OP_2nnn;
+    t.table[0x3] = &Chip8::OP_3xkk;
+    t.table[0x4] = &Chip8::OP_4xkk;
+    t.table[0x5] = &Chip8::OP_5xy0;
+    t.table[0x6] = &Chip8::OP_6xkk;
+    t.table[0x7] = &Chip8::OP_7xkk;
+    t.table[0x8] = &Chip8::Table8;
+    t.table[0x9] = &Chip8::OP_9xy0;
+    t.table[0xA] = &Chip8::OP_Annn;
+    t.table[0xB] = &Chip8::OP_Bnnn;
+    t.table[0xC] = &Chip8::OP_Cxkk;
+    t.table[0xD] = hardened ? &Chip8::OP_Dxyn_Hardened : &Chip8::OP_Dxyn;
+    t.table[0xE] = &Chip8::TableE;
+    t.table[0xF] = &Chip8::TableF;
+
+
+    for (size_t i = 0; i <= 0xF; i++)
+    {
+        t.table0[i] = &Chip8::OP_NULL;
+        t.table8[i] = &Chip8::OP_NULL;
+        t.tableE[i] = &Chip8::OP_NULL;
+    }
 
 
+    // Tables for repeating digits
+    t.table0[0x0] = &Chip8::OP_00E0;
+    t.table0[0xE] = hardened ? &Chip8::OP_00EE_Hardened : &Chip8::OP_00EE;
 
-    Chip8() :randGen(std::chrono::system_clock::now().time_since_epoch().count())
-    {
-        // Initialize PC
-        pc = START_ADDRESS;
+    // Functions pointers that indexes correctly
+    t.table8[0x0] = &Chip8::OP_8xy0;
+    t.table8[0x1] = &Chip8::OP_8xy1;
+    t.table8[0x2] = &Chip8::OP_8xy2;
+    t.table8[0x3] = &Chip8::OP_8xy3;
+    t.table8[0x4] = &Chip8::OP_8xy4;
+    t.table8[0x5] = &Chip8::OP_8xy5;
+    t.table8[0x6] = &Chip8::OP_8xy6;
+    t.table8[0x7] = &Chip8::OP_8xy7;
+    t.table8[0xE] = &Chip8::OP_8xyE;
 
-        // Load fonts into memory
-        for (unsigned int i = 0; i < FONTSET_SIZE; ++i)
-        {
-            memory[FONTSET_START_ADDRESS + i] = fontset[i];
-        }
+    t.tableE[0x1] = hardened ? &Chip8::OP_ExA1_Hardened : &Chip8::OP_ExA1;
+    t.tableE[0xE] = hardened ? &Chip8::OP_Ex9E_Hardened : &Chip8::OP_Ex9E;
 
-        // Initialize Random Number Generator (RNG)
-        randByte = std::uniform_int_distribution<uint8_t>(0, 255U);
-
-        // Array of function pointers for the first digits ($0 to $F) of the opcode
-        table[0x0] = &Chip8::Table0;
-        table[0x1] = &Chip8::OP_1nnn;
-        table[0x2] = &Chip8::OP_2nnn;
-        table[0x3] = &Chip8::OP_3xkk;
-        table[0x4] = &Chip8::OP_4xkk;
-        table[0x5] = &Chip8::OP_5xy0;
-        table[0x6] = &Chip8::OP_6xkk;
-        table[0x7] = &Chip8::OP_7xkk;
-        table[0x8] = &Chip8::Table8;
-        table[0x9] = &Chip8::OP_9xy0;
-        table[0xA] = &Chip8::OP_Annn;
-        table[0xB] = &Chip8::OP_Bnnn;
-        table[0xC] = &Chip8::OP_Cxkk;
-        table[0xD] = &Chip8::OP_Dxyn;
-        table[0xE] = &Chip8::TableE;
-        table[0xF] = &Chip8::TableF;
-
-
-        for (size_t i = 0; i <= 0xE; i++)
-        {
-            table0[i] = &OP_NULL;
-            table8[i] = &OP_NULL;
-            tableE[i] = &OP_NULL;
-        }
 
+    for (size_t i = 0; i <= 0xFF; i++)
+    {
+        t.tableF[i] = &Chip8::OP_NULL;
+    }
+
+    // Function pointers that indexes correctly
+    t.tableF[0x07] = &Chip8::OP_Fx07;
+    t.tableF[0x0A] = &Chip8::OP_Fx0A;
+    t.tableF[0x15] = &Chip8::OP_Fx15;
+    t.tableF[0x18] = &Chip8::OP_Fx18;
+    t.tableF[0x1E] = &Chip8::OP_Fx1E;
+    t.tableF[0x29] = &Chip8::OP_Fx29;
+    t.tableF[0x33] = hardened ? &Chip8::OP_Fx33_Hardened : &Chip8::OP_Fx33;
+    t.tableF[0x55] = hardened ? &Chip8::OP_Fx55_Hardened : &Chip8::OP_Fx55;
+    t.tableF[0x65] = hardened ? &Chip8::OP_Fx65_Hardened : &Chip8::OP_Fx65;
 
-        // Tables for repeating digits
-        table0[0x0] = &OP_00E0;
-        table0[0xE] = &OP_00EE;
+    return t;
+}
 
-        // Functions pointers that indexes correctly
-        table8[0x0] = &OP_8xy0;
-        table8[0x1] = &OP_8xy1;
-        table8[0x2] = &OP_8xy2;
-        table8[0x3] = &OP_8xy3;
-        table8[0x4] = &OP_8xy4;
-        table8[0x5] = &OP_8xy5;
-        table8[0x6] = &OP_8xy6;
-        table8[0x7] = &OP_8xy7;
-        table8[0xE] = &OP_8xyE;
 
-        tableE[0x1] = &OP_ExA1;
-        tableE[0xE] = &OP_Ex9E;
+// Built once on first use (thread-safe) and shared read-only by every instance
+Chip8::DispatchTables const& Chip8::GetTables(bool hardened)
+{
+    static const DispatchTables normalTables = BuildTables(false);
+    static const DispatchTables hardenedTables = BuildTables(true);
 
+    return hardened ? hardenedTables : normalTables;
+}
 
-        for (size_t i = 0; i <= 0x65; i++)
-        {
-            tableF[i] = &OP_NULL;
-        }
 
-        // Function pointers that indexes correctly
-        tableF[0x07] = &OP_Fx07;
-        tableF[0x0A] = &OP_Fx0A;
-        tableF[0x15] = &OP_Fx15;
-        tableF[0x18] = &OP_Fx18;
-        tableF[0x1E] = &OP_Fx1E;
-        tableF[0x29] = &OP_Fx29;
-        tableF[0x33] = &OP_Fx33;
-        tableF[0x55] = &OP_Fx55;
-        tableF[0x65] = &OP_Fx65;
+// Resolves an opcode to the handler Cycle() would end up running, following the same sub-table indexing
+// as Table0/Table8/TableE/TableF. Lets tools outside the core (RomAnalyzer) decode exactly like the core does.
+Chip8::Chip8Func Chip8::Decode(uint16_t opcode, bool hardened)
+{
+    DispatchTables const& t = GetTables(hardened);
+
+    switch ((opcode & 0xF000u) >> 12u)
+    {
+        case 0x0: return t.table0[opcode & 0x000Fu];
+        case 0x8: return t.table8[opcode & 0x000Fu];
+        case 0xE: return t.tableE[opcode & 0x000Fu];
+        case 0xF: return t.tableF[opcode & 0x00FFu];
+        default:  return t.table[(opcode & 0xF000u) >> 12u];
     }
+}
 
 
 
-    // Loads instructions into memory in a ROM file.
-    void LoadROM(char const* filename)
-    {
-        // Open the file as a stream of binary and move the file pointer to the end
-        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+Chip8::Chip8()
+{
+    // Initialize Random Number Generator (RNG), call Seed() afterwards for a reproducible run
+    Seed(static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()));
 
-        if (file.is_open())
-        {
-            // Get size of file and allocate a buffer to hold the contents
-            std::streampos size = file.tellg();
-            char* buffer = new char[size];
+    Reset();
+}
 
-            // Go back to the beginning of the file and fill the buffer
-            file.seekg(0, std::ios::beg);
-            file.read(buffer, size);
-            file.close();
 
-            // Load the ROM contents into the Chip8's memory, starting at 0x200
-            for (long i = 0; i < size; ++i)
-            {
-                memory[START_ADDRESS + i] = buffer[i];
-            }
+// Puts the machine back into its power-on state so it can be reused for another ROM (the RNG keeps running,
+// call Seed() after Reset() to replay a session)
+void Chip8::Reset()
+{
+    memset(registers, 0, sizeof(registers));
+    memset(memory, 0, sizeof(memory));
+    memset(stack, 0, sizeof(stack));
+    memset(keypad, 0, sizeof(keypad));
+    memset(video, 0, sizeof(video));
 
-            // Free the buffer
-            delete[] buffer;
-        }
-    }
+    index = 0;
+    sp = 0;
+    delayTimer = 0;
+    soundTimer = 0;
+    opcode = 0;
 
+    // Initialize PC
+    pc = START_ADDRESS;
 
+    // Load fonts into memory
+    memcpy(&memory[FONTSET_START_ADDRESS], fontset, FONTSET_SIZE);
 
-    // Characters / Sprites (5 bytes each)
-    const static unsigned int FONTSET_SIZE = 80;
+    tables = &GetTables(false);
+    fusion = nullptr;
+    profile = RomProfile();
 
-    uint8_t fontset[FONTSET_SIZE] =
-    {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-    };
+    // Everything was rewritten
+    dirtyPages = 0xFFFFu;
+    videoDirtyRows = 0xFFFFFFFFu;
+    videoDirtyBands = 0xFu;
+}
 
 
-    // ------- INSTRUCTIONS --------
+// Set once at startup, before any ROM is loaded
+void Chip8::UseRomDatabase(RomDatabase const* database)
+{
+    romDatabase = database;
+}
 
 
-    // CLS ~~ Clear the display
-    void OP_00E0()
-    {
-        memset(video, 0, sizeof(video));
-    }
 
+// Loads instructions into memory in a ROM file.
+void Chip8::LoadROM(char const* filename)
+{
+    // Open the file as a stream of binary and move the file pointer to the end
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
 
-    // RET ~~ Return from a subroutine
-    void OP_00EE()
+    if (file.is_open())
     {
-        --sp;
-        pc = stack[sp];
-    }
+        // Get size of file and allocate a buffer to hold the contents
+        std::streampos size = file.tellg();
+        char* buffer = new char[size];
 
+        // Go back to the beginning of the file and fill the buffer
+        file.seekg(0, std::ios::beg);
+        file.read(buffer, size);
+        file.close();
 
-    // JP addr ~~ Jump to location nnn (interpreter sets PC to nnn)
-    void OP_1nnn()
-    {
-        uint16_t address = opcode & 0x0FFFu;
+        // Load the ROM contents into the Chip8's memory, starting at 0x200
+        LoadROM(reinterpret_cast<uint8_t const*>(buffer), static_cast<size_t>(size));
 
-        pc = address;
+        // Free the buffer
+        delete[] buffer;
     }
+}
+
 
+// Loads instructions into memory from a buffer (used by the fuzzer and benchmarks, no file needed)
+void Chip8::LoadROM(uint8_t const* data, size_t size)
+{
+    // A plan built for whatever was loaded before doesn't describe this ROM
+    fusion = nullptr;
+
+    // Anything that doesn't fit between 0x200 and the end of memory is dropped
+    size = std::min<size_t>(size, sizeof(memory) - START_ADDRESS);
 
-    // CALL addr ~~ Call subroutine at nnn
-    void OP_2nnn()
+    for (size_t i = 0; i < size; ++i)
     {
-        uint16_t address = opcode & 0x0FFFul;
+        memory[START_ADDRESS + i] = data[i];
+    }
 
-        stack[sp] = pc; // puts current PC on top of stack, current PC holds the next instruction after this CALL.
-        ++sp;
-        pc = address;
+    if (size > 0)
+    {
+        MarkWritten(START_ADDRESS, START_ADDRESS + static_cast<unsigned int>(size) - 1);
     }
 
+    // Pick up the tuned settings for this ROM, if there are any
+    uint64_t hash = RomDatabase::Hash(data, size);
 
-    // SE Vx, byte ~~ Skip next instruction if Vx = kk
-    void OP_3xkk()
+    if (romDatabase != nullptr)
     {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t byte = opcode & 0x00FFU;
-
-        if (registers[Vx] == byte)
-        {
-            pc += 2;
-        }
+        profile = romDatabase->Find(hash);
     }
+    else
+    {
+        profile = RomProfile();
+        profile.hash = hash;
+    }
+}
 
 
 
-    // SNE Vx, byte ~~ Skip next instruction if Vx != kk
-    void OP_4xkk()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t byte = opcode & 0x00FFU;
+// Hardened mode points the machine at the dispatch tables with the masked/clipped handlers for everything
+// that touches memory, the stack, the keypad or the video buffer. The unchecked handlers stay untouched so the
+// normal path pays nothing.
+void Chip8::SetHardened(bool enabled)
+{
+    tables = &GetTables(enabled);
+}
 
-        if (registers[Vx] != byte)
-        {
-            pc += 2;
-        }
-    }
 
 
+// Runs the fused sequences in plan (built for the ROM currently loaded) from Run(), nullptr turns fusion off
+void Chip8::SetFusion(FusionPlan const* plan)
+{
+    fusion = plan;
+}
 
-    // SE Vx, Vy ~~ Skip next instruction if Vx = Vy
-    void OP_5xy0()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-        if (registers[Vx] == registers[Vy])
-        {
-            pc += 2;
-        }
-    }
 
+// Seeds the Cxkk generator. The same seed gives the same bytes on every compiler and platform, and since the
+// whole generator is rngState it is saved and restored along with the rest of the machine.
+void Chip8::Seed(uint32_t seed)
+{
+    // xorshift never leaves the all-zero state, so swap it for a fixed non-zero one
+    rngState = (seed != 0) ? seed : 0x2545F491u;
+}
 
-    // LD Vx, byte ~~ Set Vx = kk
-    void OP_6xkk()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t byte = opcode & 0x00FFU;
 
-        registers[Vx] == byte;
-    }
+// xorshift32 (Marsaglia), the top byte is the best mixed one
+uint8_t Chip8::NextRandomByte()
+{
+    uint32_t x = rngState;
 
+    x ^= x << 13u;
+    x ^= x >> 17u;
+    x ^= x << 5u;
 
-    // ADD Vx, byte ~~ Set Vx = Vx + kk
-    void OP_7xkk()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t byte = opcode & 0x00FFU;
+    rngState = x;
 
-        registers[Vx] += byte;
-    }
+    return static_cast<uint8_t>(x >> 24u);
+}
 
 
-    // LD Vx, Vy ~~ Set Vx = Vy
-    void OP_8xy0()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-        registers[Vx] = registers[Vy];
-    }
+// Records that memory[first..last] was written, a range never spans more than two pages here
+void Chip8::MarkWritten(unsigned int first, unsigned int last)
+{
+    dirtyPages |= (1u << ((first >> PAGE_SHIFT) & 0xFu)) | (1u << ((last >> PAGE_SHIFT) & 0xFu));
+}
 
 
-    // OR Vx, Vy ~~ Set Vx = Vx OR Vy
-    void OP_8xy1()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+// Records that an 8 pixel wide sprite was drawn at x, y. Rows past the bottom are marked at the top and bands
+// past the right edge on the left, which marks a little more than was drawn but never less.
+void Chip8::MarkDrawn(unsigned int x, unsigned int y, unsigned int height)
+{
+    uint64_t rows = ((1ull << height) - 1u) << y;
+    videoDirtyRows |= static_cast<uint32_t>(rows | (rows >> VIDEO_HEIGHT));
+    videoDirtyBands |= static_cast<uint8_t>((1u << ((x >> 4u) & 0x3u)) | (1u << (((x + 7u) >> 4u) & 0x3u)));
+}
 
-        registers[Vx] |= registers[Vy];
-    }
 
 
-    // AND Vx, Vy ~~ Set Vx = Vx AND Vy
-    void OP_8xy2()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+// ------- INSTRUCTIONS --------
 
-        registers[Vx] &= registers[Vy];
-    }
 
+// CLS ~~ Clear the display
+void Chip8::OP_00E0()
+{
+    memset(video, 0, sizeof(video));
+    videoDirtyRows = 0xFFFFFFFFu;
+    videoDirtyBands = 0xFu;
+}
 
-    // XOR Vx, Vy ~~ Set Vx = Vx XOR Vy
-    void OP_8xy3()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-        registers[Vx] ^= registers[Vy];
-    }
+// RET ~~ Return from a subroutine
+void Chip8::OP_00EE()
+{
+    --sp;
+    pc = stack[sp];
+}
 
 
-    // ADD Vx, Vy ~~ Set Vx = Vx + Vy and Set VF = carry (ie. ADD but with a flag for overflow)
-    void OP_8xy4()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+// JP addr ~~ Jump to location nnn (interpreter sets PC to nnn)
+void Chip8::OP_1nnn()
+{
+    uint16_t address = opcode & 0x0FFFu;
 
-        uint16_t sum = registers[Vx] + registers[Vy];
+    pc = address;
+}
 
-        if (sum > 255U) // ie. > 1 byte
-        {
-            registers[0xF] = 1;
-        }
-        else
-        {
-            registers[0xF] = 0;
-        }
 
-        registers[Vx] = sum & 0xFFu;
-    }
+// CALL addr ~~ Call subroutine at nnn
+void Chip8::OP_2nnn()
+{
+    uint16_t address = opcode & 0x0FFFul;
 
+    stack[sp] = pc; // puts current PC on top of stack, current PC holds the next instruction after this CALL.
+    ++sp;
+    pc = address;
+}
 
-    // SUB Vx, Vy ~~ Set Vx = Vx - Vy and Set VF = NOT borrow (ie. Substraction with a flag for negative sign)
-    void OP_8xy5()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-        if (registers[Vx] > registers[Vy])
-        {
-            registers[0xF] = 1;
-        }
-        else
-        {
-            registers[0xF] = 0;
-        }
+// SE Vx, byte ~~ Skip next instruction if Vx = kk
+void Chip8::OP_3xkk()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t byte = opcode & 0x00FFU;
 
-        registers[Vx] -= registers[Vy];
+    if (registers[Vx] == byte)
+    {
+        pc += 2;
     }
+}
 
 
-    // SHR Vx ~~ Set Vx = Vx SHR 1 (ie. right-shift), least significant bit is saved in VF.
-    void OP_8xy6()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-        registers[0xF] = (registers[Vx] & 0x1u); // Saves LSB in VF
+// SNE Vx, byte ~~ Skip next instruction if Vx != kk
+void Chip8::OP_4xkk()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t byte = opcode & 0x00FFU;
 
-        registers[Vx] >>= 1;
+    if (registers[Vx] != byte)
+    {
+        pc += 2;
     }
+}
+
+
 
+// SE Vx, Vy ~~ Skip next instruction if Vx = Vy
+void Chip8::OP_5xy0()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-    // SUBN Vx, Vy ~~ Set Vx = Vy - Vx, rest is same as OP_8xy5()
-    void OP_8xy7()
+    if (registers[Vx] == registers[Vy])
     {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+        pc += 2;
+    }
+}
 
 
-        if (registers[Vy] > registers[Vx])
-        {
-            registers[0xF] = 1;
-        }
-        else
-        {
-            registers[0xF] = 0;
-        }
+// LD Vx, byte ~~ Set Vx = kk
+void Chip8::OP_6xkk()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t byte = opcode & 0x00FFU;
 
-        registers[Vx] = registers[Vy] - registers[Vx];
-    }
+    registers[Vx] = byte;
+}
 
 
-    // SHL Vx {, Vy} ~~ Set Vx = Vy SHL 1 (ie. left shift), most significant bit is saved in Vf
-    void OP_8xyE()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+// ADD Vx, byte ~~ Set Vx = Vx + kk
+void Chip8::OP_7xkk()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t byte = opcode & 0x00FFU;
 
-        registers[0xF] = (registers[Vx] & 0x80u) >> 7u; // Saves MSB in VF
+    registers[Vx] += byte;
+}
 
-        registers[Vx] <<= 1;
-    }
 
+// LD Vx, Vy ~~ Set Vx = Vy
+void Chip8::OP_8xy0()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-    // SNE Vx, Vy
-    void OP_8xyE()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    registers[Vx] = registers[Vy];
+}
 
-        registers[0xF] = (registers[Vx] & 0x80u) >> 7u; // Saves MSB in VF
 
-        registers[Vx] <<= 1;
-    }
+// OR Vx, Vy ~~ Set Vx = Vx OR Vy
+void Chip8::OP_8xy1()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
+    registers[Vx] |= registers[Vy];
+}
 
-    // SNE Vx, Vy ~~ Skip next instruction if Vx != Vy
-    void OP_9xy0()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-        if (registers[Vx] != registers[Vy])
-        {
-            pc += 2;
-        }
-    }
+// AND Vx, Vy ~~ Set Vx = Vx AND Vy
+void Chip8::OP_8xy2()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
+    registers[Vx] &= registers[Vy];
+}
 
-    // LD I, addr ~~ Set I = nnn
-    void OP_Annn()
-    {
-        uint16_t address = opcode & 0x0FFFu;
 
-        index = address;
-    }
+// XOR Vx, Vy ~~ Set Vx = Vx XOR Vy
+void Chip8::OP_8xy3()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
+    registers[Vx] ^= registers[Vy];
+}
 
-    // JP V0, addr ~~ Jump to location nnn + V0
-    void OP_Bnnn()
-    {
-        uint16_t address = opcode & 0x0FFFu;
 
-        pc = registers[0] + address;
+// ADD Vx, Vy ~~ Set Vx = Vx + Vy and Set VF = carry (ie. ADD but with a flag for overflow)
+void Chip8::OP_8xy4()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+
+    uint16_t sum = registers[Vx] + registers[Vy];
+
+    if (sum > 255U) // ie. > 1 byte
+    {
+        registers[0xF] = 1;
     }
+    else
+    {
+        registers[0xF] = 0;
+    }
+
+    registers[Vx] = sum & 0xFFu;
+}
 
 
-    // RND Vx, byte ~~ Set Vx = random byte and kk
-    void OP_Cxkk()
+// SUB Vx, Vy ~~ Set Vx = Vx - Vy and Set VF = NOT borrow (ie. Substraction with a flag for negative sign)
+void Chip8::OP_8xy5()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+
+    if (registers[Vx] > registers[Vy])
     {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t byte = opcode & 0x00F0u;
+        registers[0xF] = 1;
+    }
+    else
+    {
+        registers[0xF] = 0;
+    }
+
+    registers[Vx] -= registers[Vy];
+}
+
+
+// SHR Vx ~~ Set Vx = Vx SHR 1 (ie. right-shift), least significant bit is saved in VF.
+void Chip8::OP_8xy6()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    registers[0xF] = (registers[Vx] & 0x1u); // Saves LSB in VF
 
-        registers[Vx] = randByte(randGen) & byte;
+    registers[Vx] >>= 1;
+}
+
+
+// SUBN Vx, Vy ~~ Set Vx = Vy - Vx, rest is same as OP_8xy5()
+void Chip8::OP_8xy7()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+
+
+    if (registers[Vy] > registers[Vx])
+    {
+        registers[0xF] = 1;
     }
+    else
+    {
+        registers[0xF] = 0;
+    }
+
+    registers[Vx] = registers[Vy] - registers[Vx];
+}
+
+
+// SHL Vx {, Vy} ~~ Set Vx = Vy SHL 1 (ie. left shift), most significant bit is saved in Vf
+void Chip8::OP_8xyE()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    registers[0xF] = (registers[Vx] & 0x80u) >> 7u; // Saves MSB in VF
 
+    registers[Vx] <<= 1;
+}
 
-    // DRW Vx, Vy, nibble ~~ Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision
-    void OP_Dxyn()
+
+// SNE Vx, Vy ~~ Skip next instruction if Vx != Vy
+void Chip8::OP_9xy0()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+
+    if (registers[Vx] != registers[Vy])
     {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-        uint8_t height = opcode & 0x000Fu;
+        pc += 2;
+    }
+}
 
-        // Wrap if going beyond screen boundaries
-        uint8_t xPos = registers[Vx] % VIDEO_WIDTH;
-        uint8_t yPos = registers[Vy] % VIDEO_HEIGHT;
 
-        registers[0xF] = 0;
+// LD I, addr ~~ Set I = nnn
+void Chip8::OP_Annn()
+{
+    uint16_t address = opcode & 0x0FFFu;
+
+    index = address;
+}
+
+
+// JP V0, addr ~~ Jump to location nnn + V0
+void Chip8::OP_Bnnn()
+{
+    uint16_t address = opcode & 0x0FFFu;
+
+    pc = registers[0] + address;
+}
+
+
+// RND Vx, byte ~~ Set Vx = random byte and kk
+void Chip8::OP_Cxkk()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t byte = opcode & 0x00FFu;
+
+    registers[Vx] = NextRandomByte() & byte;
+}
+
+
+// DRW Vx, Vy, nibble ~~ Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision
+void Chip8::OP_Dxyn()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t height = opcode & 0x000Fu;
+
+    // Wrap the starting position if going beyond screen boundaries
+    uint8_t xPos = registers[Vx] % VIDEO_WIDTH;
+    uint8_t yPos = registers[Vy] % VIDEO_HEIGHT;
+
+    // The sprite itself is clipped at the right and bottom edges, the column mask turns off sprite bits past the right edge
+    unsigned int rows = std::min(static_cast<unsigned int>(height), VIDEO_HEIGHT - yPos);
+    unsigned int cols = std::min(8u, VIDEO_WIDTH - xPos);
+    uint8_t colMask = static_cast<uint8_t>(0xFF00u >> cols);
+
+    registers[0xF] = 0;
+    MarkDrawn(xPos, yPos, height);
+
+    for (unsigned int row = 0; row < rows; ++row)
+    {
+        uint8_t spriteByte = memory[index + row] & colMask;
 
-        for (unsigned int row = 0; row < height; ++row)
+        for (unsigned int col = 0; col < 8; ++col)
         {
-            uint8_t spriteByte = memory[index + row];
+            uint8_t spritePixel = spriteByte & (0x80u >> col);
 
-            for (unsigned int col = 0; col < 8; ++col)
+            // Sprite pixel is on (never true for clipped columns)
+            if (spritePixel)
             {
-                uint8_t spritePixel = spriteByte & (0x80u >> col);
                 uint32_t* screenPixel = &video[(yPos + row) * VIDEO_WIDTH + (xPos + col)];
 
-                // Sprite pixel is on
-                if (spritePixel)
+                //Screen pixel also on - collision
+                if (*screenPixel == 0xFFFFFFFF)
                 {
-                    //Screen pixel also on - collision
-                    if (*screenPixel == 0xFFFFFFFF)
-                    {
-                        registers[0xF] = 1;
-                    }
-
-                    // XOR with sprite pixel
-                    *screenPixel ^= 0xFFFFFFFF;
+                    registers[0xF] = 1;
                 }
+
+                // XOR with sprite pixel
+                *screenPixel ^= 0xFFFFFFFF;
             }
         }
-
     }
+}
 
 
-    // SKP Vx ~~ Skip next instruction if key with value Vx is pressed
-    void OP_Ex9E()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t key = registers[Vx];
+// SKP Vx ~~ Skip next instruction if key with value Vx is pressed
+void Chip8::OP_Ex9E()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t key = registers[Vx];
 
-        if (keypad[key])
-        {
-            pc += 2;
-        }
+    if (keypad[key])
+    {
+        pc += 2;
     }
+}
 
 
-    // SKNP Vx ~~ Skip next instruction if key with value Vx is NOT pressed
-    void OP_ExA1()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t key = registers[Vx];
+// SKNP Vx ~~ Skip next instruction if key with value Vx is NOT pressed
+void Chip8::OP_ExA1()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t key = registers[Vx];
 
-        if (!keypad[key])
-        {
-            pc += 2;
-        }
+    if (!keypad[key])
+    {
+        pc += 2;
     }
+}
 
 
-    // LD Vx, DT ~~ Set Vx = delay timer value
-    void OP_Fx07()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+// LD Vx, DT ~~ Set Vx = delay timer value
+void Chip8::OP_Fx07()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-        registers[Vx] - delayTimer;
-    }
+    registers[Vx] = delayTimer;
+}
 
 
 
-    // LD Vx, K ~~ Wait for a key press, and store value of key in Vx
-    void OP_Fx0A()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+// LD Vx, K ~~ Wait for a key press, and store value of key in Vx
+void Chip8::OP_Fx0A()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
 
-        if (keypad[0])
-        {
-            registers[Vx] = 0;
-        }
-        else if (keypad[1])
-        {
-            registers[Vx] = 1;
-        }
-        else if (keypad[2])
-        {
-            registers[Vx] = 2;
-        }
-        else if (keypad[3])
-        {
-            registers[Vx] = 3;
-        }
-        else if (keypad[4])
-        {
-            registers[Vx] = 4;
-        }
-        else if (keypad[5])
-        {
-            registers[Vx] = 5;
-        }
-        else if (keypad[6])
-        {
-            registers[Vx] = 6;
-        }
-        else if (keypad[7])
-        {
-            registers[Vx] = 7;
-        }
-        else if (keypad[8])
-        {
-            registers[Vx] = 8;
-        }
-        else if (keypad[9])
-        {
-            registers[Vx] = 9;
-        }
-        else if (keypad[10])
-        {
-            registers[Vx] = 10;
-        }
-        else if (keypad[11])
-        {
-            registers[Vx] = 11;
-        }
-        else if (keypad[12])
-        {
-            registers[Vx] = 12;
-        }
-        else if (keypad[13])
-        {
-            registers[Vx] = 13;
-        }
-        else if (keypad[14])
-        {
-            registers[Vx] = 14;
-        }
-        else if (keypad[15])
-        {
-            registers[Vx] = 15;
-        }
-        else
-        {
-            pc -= 2; // Simulates waiting (executes same instruction repeatedly)
-        }
+    if (keypad[0])
+    {
+        registers[Vx] = 0;
+    }
+    else if (keypad[1])
+    {
+        registers[Vx] = 1;
+    }
+    else if (keypad[2])
+    {
+        registers[Vx] = 2;
+    }
+    else if (keypad[3])
+    {
+        registers[Vx] = 3;
+    }
+    else if (keypad[4])
+    {
+        registers[Vx] = 4;
+    }
+    else if (keypad[5])
+    {
+        registers[Vx] = 5;
+    }
+    else if (keypad[6])
+    {
+        registers[Vx] = 6;
+    }
+    else if (keypad[7])
+    {
+        registers[Vx] = 7;
+    }
+    else if (keypad[8])
+    {
+        registers[Vx] = 8;
+    }
+    else if (keypad[9])
+    {
+        registers[Vx] = 9;
+    }
+    else if (keypad[10])
+    {
+        registers[Vx] = 10;
+    }
+    else if (keypad[11])
+    {
+        registers[Vx] = 11;
+    }
+    else if (keypad[12])
+    {
+        registers[Vx] = 12;
+    }
+    else if (keypad[13])
+    {
+        registers[Vx] = 13;
+    }
+    else if (keypad[14])
+    {
+        registers[Vx] = 14;
     }
+    else if (keypad[15])
+    {
+        registers[Vx] = 15;
+    }
+    else
+    {
+        pc -= 2; // Simulates waiting (executes same instruction repeatedly)
+    }
+}
 
 
-    // LD DT, Vx ~~ Set delayTimer = Vx
-    void OP_Fx15()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+// LD DT, Vx ~~ Set delayTimer = Vx
+void Chip8::OP_Fx15()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-        delayTimer = registers[Vx];
-    }
+    delayTimer = registers[Vx];
+}
 
 
-    // LD ST, Vx ~~ Set soundTimer = Vx
-    void OP_Fx18()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+// LD ST, Vx ~~ Set soundTimer = Vx
+void Chip8::OP_Fx18()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-        soundTimer += registers[Vx];
-    }
+    soundTimer += registers[Vx];
+}
 
 
-    // ADD I, Vx ~~ Set I = I + Vx
-    void OP_Fx1E()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+// ADD I, Vx ~~ Set I = I + Vx
+void Chip8::OP_Fx1E()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-        index += registers[Vx];
-    }
+    index += registers[Vx];
+}
 
 
-    // LD F, Vx ~~ Set I = location of sprite for digit Vx
-    void OP_Fx29()
-    {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t digit = registers[Vx];
+// LD F, Vx ~~ Set I = location of sprite for digit Vx
+void Chip8::OP_Fx29()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t digit = registers[Vx];
+
+    index = FONTSET_START_ADDRESS + (5 * digit); // since all characters are 5 byte each
+}
+
+
+// LD B, Vx ~~ Store BCD representation of digit Vx in memory locations I, I+1, and I+2
+void Chip8::OP_Fx33()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t value = registers[Vx];
 
-        index = FONTSET_START_ADDRESS + (5 * digit); // since all characters are 5 byte each
+    MarkWritten(index, index + 2);
+
+    // Ones-place
+    memory[index + 2] = value % 10;
+    value /= 10;
+
+
+    // Tens-place
+    memory[index + 1] = value % 10;
+    value /= 10;
+
+    // Hundreds-place
+    memory[index] = value % 10;
+}
+
+
+// LD [I], Vx ~~ Store registers V0 through Vx in memory starting at location I
+void Chip8::OP_Fx55()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    MarkWritten(index, index + Vx);
+
+    for (uint8_t i = 0; i <= Vx; ++i)
+    {
+        memory[index + i] = registers[i];
     }
+}
 
 
-    // LD B, Vx ~~ Store BCD representation of digit Vx in memory locations I, I+1, and I+2
-    void OP_Fx33()
+// LD Vx, [I] ~~ Read registers V0 through Vx from memory starting at location I
+void Chip8::OP_Fx65()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    for (uint8_t i = 0; i <= Vx; ++i)
     {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t value = registers[Vx];
+        registers[i] = memory[index + i];
+    }
+}
 
-        // Ones-place
-        memory[index + 2] = value % 10;
-        value /= 10;
 
 
-        // Tens-place
-        memory[index + 1] = value % 10;
-        value /= 10;
+// ------- HARDENED INSTRUCTIONS --------
 
-        // Hundreds-place
-        memory[index] = value % 10;
-    }
 
+// RET ~~ sp wraps around instead of underflowing
+void Chip8::OP_00EE_Hardened()
+{
+    sp = (sp - 1u) & STACK_MASK;
+    pc = stack[sp];
+}
+
+
+// CALL addr ~~ sp wraps around instead of overflowing
+void Chip8::OP_2nnn_Hardened()
+{
+    uint16_t address = opcode & 0x0FFFu;
+
+    stack[sp & STACK_MASK] = pc;
+    sp = (sp + 1u) & STACK_MASK;
+    pc = address;
+}
+
+
+// DRW Vx, Vy, nibble ~~ Clipped like OP_Dxyn, and sprite data past the end of memory wraps to the start
+void Chip8::OP_Dxyn_Hardened()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t height = opcode & 0x000Fu;
+
+    // Wrap the starting position if going beyond screen boundaries
+    uint8_t xPos = registers[Vx] % VIDEO_WIDTH;
+    uint8_t yPos = registers[Vy] % VIDEO_HEIGHT;
+
+    // Only draw the rows and columns that are on screen, the column mask turns off sprite bits past the right edge
+    unsigned int rows = std::min(static_cast<unsigned int>(height), VIDEO_HEIGHT - yPos);
+    unsigned int cols = std::min(8u, VIDEO_WIDTH - xPos);
+    uint8_t colMask = static_cast<uint8_t>(0xFF00u >> cols);
+
+    registers[0xF] = 0;
+    MarkDrawn(xPos, yPos, height);
 
-    // LD [I], Vx ~~ Store registers V0 through Vx in memory starting at location I
-    void OP_Fx55()
+    for (unsigned int row = 0; row < rows; ++row)
     {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+        uint8_t spriteByte = memory[(index + row) & MEMORY_MASK] & colMask;
 
-        for (uint8_t i = 0; i <= Vx; ++i)
+        for (unsigned int col = 0; col < 8; ++col)
         {
-            memory[index + i] = registers[i];
+            uint8_t spritePixel = spriteByte & (0x80u >> col);
+
+            // Sprite pixel is on (never true for clipped columns)
+            if (spritePixel)
+            {
+                uint32_t* screenPixel = &video[(yPos + row) * VIDEO_WIDTH + (xPos + col)];
+
+                //Screen pixel also on - collision
+                if (*screenPixel == 0xFFFFFFFF)
+                {
+                    registers[0xF] = 1;
+                }
+
+                // XOR with sprite pixel
+                *screenPixel ^= 0xFFFFFFFF;
+            }
         }
     }
+}
+
 
+// SKP Vx ~~ Only the low nibble of Vx selects a key
+void Chip8::OP_Ex9E_Hardened()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t key = registers[Vx] & KEY_MASK;
 
-    // LD Vx, [I] ~~ Read registers V0 through Vx from memory starting at location I
-    void OP_Fx65()
+    if (keypad[key])
     {
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+        pc += 2;
+    }
+}
 
-        for (uint8_t i = 0; i <= Vx; ++i)
-        {
-            registers[i] = memory[index + i];
-        }
+
+// SKNP Vx ~~ Only the low nibble of Vx selects a key
+void Chip8::OP_ExA1_Hardened()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t key = registers[Vx] & KEY_MASK;
+
+    if (!keypad[key])
+    {
+        pc += 2;
     }
+}
 
 
+// LD B, Vx ~~ BCD digits are written at I, I+1 and I+2 wrapped to 12 bits
+void Chip8::OP_Fx33_Hardened()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t value = registers[Vx];
 
+    MarkWritten(index, index + 2);
 
+    // Ones-place
+    memory[(index + 2) & MEMORY_MASK] = value % 10;
+    value /= 10;
 
-    // ------------------------ FUNCTION POINTER ---------------------------------
+    // Tens-place
+    memory[(index + 1) & MEMORY_MASK] = value % 10;
+    value /= 10;
 
+    // Hundreds-place
+    memory[index & MEMORY_MASK] = value % 10;
+}
 
-    // Array of pointers where the opcode is the index, because of scalability 
-    // #TODO there is a better faster way to do this like a hashmap or else
 
+// LD [I], Vx ~~ Addresses wrap to 12 bits
+void Chip8::OP_Fx55_Hardened()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    MarkWritten(index, index + Vx);
 
-    void Table0()
+    for (uint8_t i = 0; i <= Vx; ++i)
     {
-        ((*this).*(table0[opcode & 0x000Fu]))();
+        memory[(index + i) & MEMORY_MASK] = registers[i];
     }
+}
+
 
-    void Table8()
+// LD Vx, [I] ~~ Addresses wrap to 12 bits
+void Chip8::OP_Fx65_Hardened()
+{
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    for (uint8_t i = 0; i <= Vx; ++i)
     {
-        ((*this).*(table8[opcode & 0x000Fu]))();
+        registers[i] = memory[(index + i) & MEMORY_MASK];
     }
+}
+
+
+
+
+
+// ------------------------ FUNCTION POINTER ---------------------------------
+
+
+// Array of pointers where the opcode is the index, because of scalability 
+// #TODO there is a better faster way to do this like a hashmap or else
+
+
+void Chip8::Table0()
+{
+    ((*this).*(tables->table0[opcode & 0x000Fu]))();
+}
+
+void Chip8::Table8()
+{
+    ((*this).*(tables->table8[opcode & 0x000Fu]))();
+}
+
+void Chip8::TableE()
+{
+    ((*this).*(tables->tableE[opcode & 0x000Fu]))();
+}
+
+void Chip8::TableF()
+{
+    ((*this).*(tables->tableF[opcode & 0x00FFu]))();
+}
+
+void Chip8::OP_NULL()
+{
+}
+
+// ------- FUSED INSTRUCTIONS --------
+
+
+// LD I, addr + DRW Vx, Vy, nibble
+unsigned int Chip8::OP_Annn_Dxyn()
+{
+    index = PeekOpcode(pc) & 0x0FFFu;
+    pc += 2;
+
+    // Draw through the table so hardened mode still clips
+    opcode = PeekOpcode(pc);
+    pc += 2;
+    ((*this).*(tables->table[0xD]))();
+
+    return 2;
+}
+
+
+// LD Vx, byte + LD DT, Vx
+unsigned int Chip8::OP_6xkk_Fx15()
+{
+    uint16_t load = PeekOpcode(pc);
+    registers[(load & 0x0F00u) >> 8u] = load & 0x00FFu;
+
+    opcode = PeekOpcode(pc + 2u);
+    pc += 4;
+    delayTimer = registers[(opcode & 0x0F00u) >> 8u];
+
+    return 2;
+}
+
+
+// ADD Vx, byte + SE Vy, byte + JP addr ~~ The usual counting loop, leaves after 2 instructions when the count is reached
+unsigned int Chip8::OP_7xkk_3xkk_1nnn()
+{
+    uint16_t add = PeekOpcode(pc);
+    registers[(add & 0x0F00u) >> 8u] += add & 0x00FFu;
+
+    opcode = PeekOpcode(pc + 2u);
+    pc += 4;
+    bool done = registers[(opcode & 0x0F00u) >> 8u] == (opcode & 0x00FFu);
 
-    void TableE()
+    if (done)
     {
-        ((*this).*(tableE[opcode & 0x000Fu]))();
+        pc += 2;
+        return 2;
     }
 
-    void TableF()
+    opcode = PeekOpcode(pc);
+    pc = opcode & 0x0FFFu;
+
+    return 3;
+}
+
+
+// Any skip + JP addr ~~ Either skips the jump (1 instruction) or takes it (2 instructions)
+unsigned int Chip8::OP_Skip_1nnn()
+{
+    opcode = PeekOpcode(pc);
+    pc += 2;
+    bool skip = SkipTaken(opcode);
+
+    if (skip)
     {
-        ((*this).*(tableF[opcode & 0x00FFu]))();
+        pc += 2;
+        return 1;
     }
 
-    void OP_NULL()
+    opcode = PeekOpcode(pc);
+    pc = opcode & 0x0FFFu;
+
+    return 2;
+}
+
+
+// Condition of the skip instructions (3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1) without touching pc
+bool Chip8::SkipTaken(uint16_t skipOpcode) const
+{
+    uint8_t Vx = (skipOpcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (skipOpcode & 0x00F0u) >> 4u;
+    uint8_t byte = skipOpcode & 0x00FFu;
+
+    switch ((skipOpcode & 0xF000u) >> 12u)
     {
+        case 0x3: return registers[Vx] == byte;
+        case 0x4: return registers[Vx] != byte;
+        case 0x5: return registers[Vx] == registers[Vy];
+        case 0x9: return registers[Vx] != registers[Vy];
+        case 0xE:
+            // Decoded by the low nibble like TableE: ExxE is Ex9E, Exx1 is ExA1, anything else is OP_NULL
+            switch (skipOpcode & 0x000Fu)
+            {
+                case 0xE: return keypad[registers[Vx] & KEY_MASK] != 0;
+                case 0x1: return keypad[registers[Vx] & KEY_MASK] == 0;
+                default:  return false;
+            }
+        default:  return false;
     }
+}
 
-    // ----------------- CYCLE -------------------
 
 
+// ----------------- CYCLE -------------------
 
-    void Cycle()
-    {
-        // Fetch the next instruction in the form of an opcode
-        opcode = (memory[pc] << 8u) | memory[pc + 1];
 
-        //Increment pc
-        pc += 2;
 
-        // Decode the instruction and execute
-        ((*this).*(table[(opcode & 0xF000u) >> 12u]))();
+// Opcode stored at address (pc can run past 0xFFF via Bnnn or skips, so wrap it)
+uint16_t Chip8::PeekOpcode(uint16_t address) const
+{
+    return (memory[address & MEMORY_MASK] << 8u) | memory[(address + 1u) & MEMORY_MASK];
+}
 
-        // Decrement delay timer if it's been set
-        if (delayTimer > 0)
-        {
-            --delayTimer;
-        }
 
-        // Decrement the sound timer if it's been set
-        if (soundTimer > 0)
-        {
-            -soundTimer;
-        }
+void Chip8::Cycle()
+{
+    // Fetch the next instruction in the form of an opcode
+    opcode = PeekOpcode(pc);
+
+    //Increment pc
+    pc += 2;
+
+    // Decode the instruction and execute
+    ((*this).*(tables->table[(opcode & 0xF000u) >> 12u]))();
+}
+
+
+void Chip8::TickTimers()
+{
+    // Decrement delay timer if it's been set
+    if (delayTimer > 0)
+    {
+        --delayTimer;
     }
 
+    // Decrement the sound timer if it's been set
+    if (soundTimer > 0)
+    {
+        --soundTimer;
+    }
+}
 
 
+// Runs exactly `instructions` instructions, using the fusion plan where a whole sequence fits in what's left,
+// so the machine ends up in the same state as calling Cycle() that many times. Returns the number of dispatches.
+unsigned int Chip8::Run(unsigned int instructions)
+{
+    unsigned int dispatches = 0;
 
+    while (instructions > 0)
+    {
+        FusionPlan::Kind kind = (fusion != nullptr) ? fusion->At(pc) : FusionPlan::None;
 
-};
+        if (kind != FusionPlan::None && FusionPlan::MaxLength(kind) <= instructions)
+        {
+            switch (kind)
+            {
+                case FusionPlan::IndexDraw: instructions -= OP_Annn_Dxyn(); break;
+                case FusionPlan::LoadDelay: instructions -= OP_6xkk_Fx15(); break;
+                case FusionPlan::CountLoop: instructions -= OP_7xkk_3xkk_1nnn(); break;
+                default:                    instructions -= OP_Skip_1nnn(); break;
+            }
+        }
+        else
+        {
+            Cycle();
+            --instructions;
+        }
+
+        ++dispatches;
+    }
+
+    return dispatches;
+}
 
 
+// The delay and sound timers count down at 60 Hz, not once per instruction
+void Chip8::RunFrame()
+{
+    Run(profile.cyclesPerFrame);
+    TickTimers();
+}
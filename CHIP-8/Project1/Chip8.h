@@ -1,6 +1,204 @@
+#pragma once
 
+#include "RomDatabase.h"
+#include <cstddef>
+#include <cstdint>
 
-class Chip8
+
+class FusionPlan;
+
+
+// Laid out by how often things are touched: the CPU state Cycle() reads every instruction shares one cache
+// line, the stack and keypad share the next, then memory and the display each start on their own line.
+// The class is cache line aligned so machines packed into an array (Chip8Pool) never share a line.
+//
+// Every member is plain data (dispatch tables and fusion plans are shared and only pointed to), so copying
+// a Chip8 is a complete snapshot of the machine and assigning one back restores it.
+class alignas(64) Chip8
 {
-	
-};
\ No newline at end of file
+public:
+    const static size_t CACHE_LINE_SIZE = 64;
+
+    // Tables cover every value their index nibble/byte can take, unknown opcodes land on OP_NULL.
+    // They are the same for every machine, so only two copies exist (normal and hardened) and each
+    // instance just points at one of them.
+    typedef void (Chip8::*Chip8Func)();
+
+    struct DispatchTables
+    {
+        Chip8Func table[0xF + 1];
+        Chip8Func table0[0xF + 1];
+        Chip8Func table8[0xF + 1];
+        Chip8Func tableE[0xF + 1];
+        Chip8Func tableF[0xFF + 1];
+    };
+
+
+
+    // ------- HOT CPU STATE (one cache line) --------
+
+    alignas(CACHE_LINE_SIZE)
+    DispatchTables const* tables;   // Normal or hardened handlers
+    FusionPlan const* fusion;       // Fused sequences for the loaded ROM, nullptr when fusion is off
+    uint8_t registers[16]{};        // Storage V0 - VF (all CPU oprations)
+    uint16_t pc{};                  // Address of the next instruction to execute
+    uint16_t index{};               // Memory addresses
+    uint16_t opcode{};
+    uint8_t sp{};                   // Tracks top of stack
+    uint8_t delayTimer{};
+    uint8_t soundTimer{};
+
+    // ------- WARM STATE (one cache line) --------
+
+    alignas(CACHE_LINE_SIZE)
+    uint16_t stack[16]{};           // Tracks order of execution
+    uint8_t keypad[16]{};           // 0 - F input keys
+    uint32_t rngState{};            // xorshift32 state for Cxkk, never 0 (see Seed)
+    uint16_t dirtyPages{};          // Bit n set when the 256-byte page n of memory was written (see Chip8Fork)
+    uint32_t videoDirtyRows{};      // Bit n set when row n of video was drawn to or cleared
+    uint8_t videoDirtyBands{};      // Bit n set when pixels 16n - 16n+15 of any of those rows were
+
+    // ------- MEMORY AND DISPLAY --------
+
+    alignas(CACHE_LINE_SIZE)
+    uint8_t memory[4096]{};         // 4 bytes (interpreter, characters, intructions)
+
+    alignas(CACHE_LINE_SIZE)
+    uint32_t video[64 * 32]{};      // Pixels
+
+    RomProfile profile;             // Settings for the loaded ROM (speed)
+
+
+
+    const static unsigned int START_ADDRESS = 0x200;           // Start address for instructions in memory
+    const static unsigned int FONTSET_START_ADDRESS = 0x50;    // Start address for characters in memory
+
+    const static unsigned int VIDEO_WIDTH = 64;
+    const static unsigned int VIDEO_HEIGHT = 32;
+
+    // Masks used by the hardened handlers, memory is 4 KB (12 bit addresses) and the stack holds 16 entries
+    const static unsigned int MEMORY_MASK = 0x0FFFu;
+    const static unsigned int STACK_MASK = 0x000Fu;
+    const static unsigned int KEY_MASK = 0x000Fu;
+
+
+
+    static DispatchTables const& GetTables(bool hardened);
+
+    static Chip8Func Decode(uint16_t opcode, bool hardened = false);
+
+
+
+    Chip8();
+
+    void Reset();
+
+    void LoadROM(char const* filename);
+    void LoadROM(uint8_t const* data, size_t size);
+
+    // Database LoadROM looks profiles up in, shared by every machine in the process (nullptr for defaults)
+    static RomDatabase const* romDatabase;
+    static void UseRomDatabase(RomDatabase const* database);
+
+    void SetHardened(bool enabled);
+
+    void Seed(uint32_t seed);
+    uint8_t NextRandomByte();
+
+    void SetFusion(FusionPlan const* plan);
+
+    uint16_t PeekOpcode(uint16_t address) const;
+
+    void Cycle();
+    unsigned int Run(unsigned int instructions);
+    void TickTimers();
+
+    // One 60 Hz frame: the profile's cyclesPerFrame instructions, then the timers tick once
+    void RunFrame();
+
+    const static unsigned int PAGE_SHIFT = 8;       // Memory pages are 256 bytes, 16 of them
+    void MarkWritten(unsigned int first, unsigned int last);
+    void MarkDrawn(unsigned int x, unsigned int y, unsigned int height);
+
+
+
+    // Characters / Sprites (5 bytes each)
+    const static unsigned int FONTSET_SIZE = 80;
+
+    const static uint8_t fontset[FONTSET_SIZE];
+
+
+    // ------- INSTRUCTIONS --------
+
+    void OP_00E0();
+    void OP_00EE();
+    void OP_1nnn();
+    void OP_2nnn();
+    void OP_3xkk();
+    void OP_4xkk();
+    void OP_5xy0();
+    void OP_6xkk();
+    void OP_7xkk();
+    void OP_8xy0();
+    void OP_8xy1();
+    void OP_8xy2();
+    void OP_8xy3();
+    void OP_8xy4();
+    void OP_8xy5();
+    void OP_8xy6();
+    void OP_8xy7();
+    void OP_8xyE();
+    void OP_9xy0();
+    void OP_Annn();
+    void OP_Bnnn();
+    void OP_Cxkk();
+    void OP_Dxyn();
+    void OP_Ex9E();
+    void OP_ExA1();
+    void OP_Fx07();
+    void OP_Fx0A();
+    void OP_Fx15();
+    void OP_Fx18();
+    void OP_Fx1E();
+    void OP_Fx29();
+    void OP_Fx33();
+    void OP_Fx55();
+    void OP_Fx65();
+
+
+    // ------- HARDENED INSTRUCTIONS --------
+
+    // Same behaviour as above, but every memory, stack and keypad access is masked so a malformed ROM can't
+    // reach outside the machine (sprites are clipped to the screen in both modes). Installed by SetHardened(true).
+
+    void OP_00EE_Hardened();
+    void OP_2nnn_Hardened();
+    void OP_Dxyn_Hardened();
+    void OP_Ex9E_Hardened();
+    void OP_ExA1_Hardened();
+    void OP_Fx33_Hardened();
+    void OP_Fx55_Hardened();
+    void OP_Fx65_Hardened();
+
+
+    // ------- FUSED INSTRUCTIONS --------
+
+    // Run a whole sequence found by FusionPlan in one dispatch, starting at pc. Each one leaves the machine
+    // exactly as running its instructions one Cycle() at a time would, and returns how many instructions ran.
+
+    unsigned int OP_Annn_Dxyn();
+    unsigned int OP_6xkk_Fx15();
+    unsigned int OP_7xkk_3xkk_1nnn();
+    unsigned int OP_Skip_1nnn();
+
+    bool SkipTaken(uint16_t skipOpcode) const;
+
+
+    // ------------------------ FUNCTION POINTER ---------------------------------
+
+    void Table0();
+    void Table8();
+    void TableE();
+    void TableF();
+    void OP_NULL();
+};
@@ -0,0 +1,508 @@
+#include "Chip8Batch.h"
+#include "Chip8.h"
+#include "FusionPlan.h"
+#include "RomAnalyzer.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CHIP8_BATCH_SSE2
+#endif
+
+
+// Below this many machines per thread, waking workers costs more than it saves
+const static uint32_t MIN_MACHINES_PER_THREAD = 16;
+
+
+static unsigned int CountTrailingZeros(uint32_t value)
+{
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, value);
+    return bit;
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+
+
+// 16 pixels starting at line as 16 bits, leftmost pixel in the most significant bit
+static uint16_t PackBand(uint32_t const* line)
+{
+#ifdef CHIP8_BATCH_SSE2
+    // Pixels are 0x00000000 or 0xFFFFFFFF, saturating packs keep that down to one byte each. Reversing the
+    // dwords first puts the leftmost pixel in the top byte, where movemask wants it.
+    __m128i a = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(line)), _MM_SHUFFLE(0, 1, 2, 3));
+    __m128i b = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(line + 4)), _MM_SHUFFLE(0, 1, 2, 3));
+    __m128i c = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(line + 8)), _MM_SHUFFLE(0, 1, 2, 3));
+    __m128i d = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(line + 12)), _MM_SHUFFLE(0, 1, 2, 3));
+
+    __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(d, c), _mm_packs_epi32(b, a));
+
+    return static_cast<uint16_t>(_mm_movemask_epi8(bytes));
+#else
+    uint32_t bits = 0;
+
+    for (unsigned int x = 0; x < 16; ++x)
+    {
+        bits |= (line[x] & 1u) << (15u - x);
+    }
+
+    return static_cast<uint16_t>(bits);
+#endif
+}
+
+
+
+struct Chip8Batch
+{
+    explicit Chip8Batch(uint32_t count);
+    ~Chip8Batch();
+
+    // Separate from the constructor so a thread that fails to start can't leave joinable threads behind in
+    // an unwinding vector (std::terminate). False if one couldn't be started, the ones that were are joined.
+    bool StartWorkers(uint32_t threads);
+    void StopWorkers();
+
+    void ResetMachine(uint32_t machine);
+    void Step(uint16_t const* keys, uint32_t frames, uint64_t* framesOut, int32_t* rewardsOut);
+
+    uint8_t RewardByte(Chip8 const& chip8) const;
+    void StepRange(uint32_t begin, uint32_t end);
+    void StepChunk(uint32_t chunk, uint32_t chunks);
+    void WorkerLoop(uint32_t chunk);
+
+    uint32_t count;
+    std::unique_ptr<Chip8[]> machines;      // One contiguous block, each machine on its own cache lines
+    std::unique_ptr<uint64_t[]> packed;     // Packed frame of every machine, kept up to date row by row
+
+    std::vector<uint8_t> rom;
+    FusionPlan fusionPlan;
+    bool fusionUsable = false;
+    bool hardened = false;
+    uint32_t seed = 0;
+    int rewardSource = CHIP8_REWARD_NONE;
+    uint16_t rewardLocation = 0;
+
+    // The step being run, read by the workers once they are woken
+    struct Job
+    {
+        uint16_t const* keys;
+        uint32_t frames;
+        uint64_t* framesOut;
+        int32_t* rewardsOut;
+    };
+
+    Job job{};
+
+    std::vector<std::thread> workers;       // Worker n runs chunk n + 1, the calling thread runs chunk 0
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    uint64_t generation = 0;                // Bumped for every step the workers take part in
+    uint32_t pending = 0;                   // Workers still running the current step
+    bool stopping = false;
+};
+
+
+
+Chip8Batch::Chip8Batch(uint32_t count)
+    : count(count), machines(new Chip8[count]), packed(new uint64_t[static_cast<size_t>(count) * CHIP8_FRAME_ROWS]())
+{
+}
+
+
+Chip8Batch::~Chip8Batch()
+{
+    StopWorkers();
+}
+
+
+bool Chip8Batch::StartWorkers(uint32_t threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // No point in threads that would never get a full share of machines
+    threads = std::min(threads, std::max(1u, count / MIN_MACHINES_PER_THREAD));
+
+    try
+    {
+        workers.reserve(threads - 1);
+
+        for (uint32_t i = 1; i < threads; ++i)
+        {
+            workers.emplace_back(&Chip8Batch::WorkerLoop, this, i);
+        }
+    }
+    catch (...)
+    {
+        StopWorkers();
+        return false;
+    }
+
+    return true;
+}
+
+
+void Chip8Batch::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    workers.clear();
+}
+
+
+void Chip8Batch::ResetMachine(uint32_t machine)
+{
+    Chip8& chip8 = machines[machine];
+
+    chip8.Reset();
+    chip8.SetHardened(hardened);
+    chip8.Seed(seed + machine);
+    chip8.LoadROM(rom.data(), rom.size());
+
+    if (fusionUsable)
+    {
+        chip8.SetFusion(&fusionPlan);
+    }
+}
+
+
+uint8_t Chip8Batch::RewardByte(Chip8 const& chip8) const
+{
+    switch (rewardSource)
+    {
+        case CHIP8_REWARD_REGISTER: return chip8.registers[rewardLocation & 0xFu];
+        case CHIP8_REWARD_MEMORY:   return chip8.memory[rewardLocation & Chip8::MEMORY_MASK];
+        default:                    return 0;
+    }
+}
+
+
+void Chip8Batch::StepRange(uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        Chip8& chip8 = machines[i];
+
+        for (unsigned int key = 0; key < 16; ++key)
+        {
+            chip8.keypad[key] = (job.keys[i] >> key) & 1u;
+        }
+
+        uint8_t before = RewardByte(chip8);
+
+        for (uint32_t frame = 0; frame < job.frames; ++frame)
+        {
+            chip8.RunFrame();
+        }
+
+        if (job.rewardsOut != nullptr)
+        {
+            job.rewardsOut[i] = static_cast<int32_t>(RewardByte(chip8)) - static_cast<int32_t>(before);
+        }
+
+        if (job.framesOut == nullptr)
+        {
+            // The dirty rows and bands keep adding up until a step asks for frames
+            continue;
+        }
+
+        // Only the rows and 16 pixel bands drawn since frames were last packed are packed again. Video is 8 KB
+        // per machine, reading all of it every step would cost far more than emulating the frame.
+        uint64_t* rows = &packed[static_cast<size_t>(i) * CHIP8_FRAME_ROWS];
+
+        for (uint32_t dirty = chip8.videoDirtyRows; dirty != 0; dirty &= dirty - 1u)
+        {
+            unsigned int y = CountTrailingZeros(dirty);
+            uint64_t row = rows[y];
+
+            for (unsigned int band = 0; band < 4; ++band)
+            {
+                if (((chip8.videoDirtyBands >> band) & 1u) == 0)
+                {
+                    continue;
+                }
+
+                uint64_t bits = PackBand(&chip8.video[y * Chip8::VIDEO_WIDTH + band * 16u]);
+                unsigned int shift = 48u - band * 16u;
+                row = (row & ~(0xFFFFull << shift)) | (bits << shift);
+            }
+
+            rows[y] = row;
+        }
+
+        chip8.videoDirtyRows = 0;
+        chip8.videoDirtyBands = 0;
+
+        memcpy(&job.framesOut[static_cast<size_t>(i) * CHIP8_FRAME_ROWS], rows, CHIP8_FRAME_ROWS * sizeof(uint64_t));
+    }
+}
+
+
+void Chip8Batch::StepChunk(uint32_t chunk, uint32_t chunks)
+{
+    uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * chunk / chunks);
+    uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (chunk + 1) / chunks);
+
+    StepRange(begin, end);
+}
+
+
+void Chip8Batch::WorkerLoop(uint32_t chunk)
+{
+    uint64_t seen = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            seen = generation;
+        }
+
+        StepChunk(chunk, static_cast<uint32_t>(workers.size()) + 1);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if (--pending == 0)
+            {
+                finished.notify_one();
+            }
+        }
+    }
+}
+
+
+void Chip8Batch::Step(uint16_t const* keys, uint32_t frames, uint64_t* framesOut, int32_t* rewardsOut)
+{
+    job = { keys, frames, framesOut, rewardsOut };
+
+    if (workers.empty())
+    {
+        StepRange(0, count);
+        return;
+    }
+
+    // The lock orders the job write above before the workers read it
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending = static_cast<uint32_t>(workers.size());
+        ++generation;
+    }
+
+    wake.notify_all();
+
+    StepChunk(0, static_cast<uint32_t>(workers.size()) + 1);
+
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [&] { return pending == 0; });
+}
+
+
+
+// ------- C INTERFACE --------
+
+// Nothing may throw across the C boundary, allocation failures come back as NULL from create
+
+extern "C" {
+
+
+uint32_t chip8_api_version(void)
+{
+    return CHIP8_API_VERSION;
+}
+
+
+Chip8Batch* chip8_batch_create(uint32_t count, uint32_t threads)
+{
+    if (count == 0)
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        std::unique_ptr<Chip8Batch> batch(new Chip8Batch(count));
+
+        if (!batch->StartWorkers(threads))
+        {
+            return nullptr;
+        }
+
+        return batch.release();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+
+void chip8_batch_destroy(Chip8Batch* batch)
+{
+    delete batch;
+}
+
+
+uint32_t chip8_batch_count(Chip8Batch const* batch)
+{
+    return (batch != nullptr) ? batch->count : 0;
+}
+
+
+int chip8_batch_load_rom(Chip8Batch* batch, uint8_t const* data, size_t size)
+{
+    if (batch == nullptr || (data == nullptr && size > 0))
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    try
+    {
+        batch->rom.assign(data, data + size);
+    }
+    catch (...)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    // One plan for the whole batch, every machine runs the same code
+    Chip8& first = batch->machines[0];
+    first.Reset();
+    first.LoadROM(batch->rom.data(), batch->rom.size());
+
+    batch->fusionPlan = FusionPlan();
+    batch->fusionUsable = batch->fusionPlan.Build(first, RomAnalyzer::Analyze(first));
+
+    return chip8_batch_reset(batch, CHIP8_ALL_MACHINES);
+}
+
+
+int chip8_batch_reset(Chip8Batch* batch, uint32_t machine)
+{
+    if (batch == nullptr || (machine != CHIP8_ALL_MACHINES && machine >= batch->count))
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    if (batch->rom.empty())
+    {
+        return CHIP8_ERROR_NO_ROM;
+    }
+
+    if (machine != CHIP8_ALL_MACHINES)
+    {
+        batch->ResetMachine(machine);
+        return CHIP8_OK;
+    }
+
+    for (uint32_t i = 0; i < batch->count; ++i)
+    {
+        batch->ResetMachine(i);
+    }
+
+    return CHIP8_OK;
+}
+
+
+int chip8_batch_seed(Chip8Batch* batch, uint32_t seed)
+{
+    if (batch == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    batch->seed = seed;
+
+    for (uint32_t i = 0; i < batch->count; ++i)
+    {
+        batch->machines[i].Seed(seed + i);
+    }
+
+    return CHIP8_OK;
+}
+
+
+int chip8_batch_set_hardened(Chip8Batch* batch, int enabled)
+{
+    if (batch == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    batch->hardened = (enabled != 0);
+
+    for (uint32_t i = 0; i < batch->count; ++i)
+    {
+        batch->machines[i].SetHardened(batch->hardened);
+    }
+
+    return CHIP8_OK;
+}
+
+
+int chip8_batch_set_reward(Chip8Batch* batch, int source, uint16_t location)
+{
+    if (batch == nullptr ||
+        (source != CHIP8_REWARD_NONE && source != CHIP8_REWARD_REGISTER && source != CHIP8_REWARD_MEMORY))
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    batch->rewardSource = source;
+    batch->rewardLocation = location;
+
+    return CHIP8_OK;
+}
+
+
+int chip8_batch_step(Chip8Batch* batch, uint16_t const* keys, uint32_t frames,
+    uint64_t* frames_out, int32_t* rewards_out)
+{
+    if (batch == nullptr || keys == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    if (batch->rom.empty())
+    {
+        return CHIP8_ERROR_NO_ROM;
+    }
+
+    batch->Step(keys, frames, frames_out, rewards_out);
+
+    return CHIP8_OK;
+}
+
+
+}
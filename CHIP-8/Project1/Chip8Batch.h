@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+ * C interface for driving many machines at once from other languages (training code, bots).
+ *
+ * A batch owns `count` machines running the same ROM. One chip8_batch_step() call applies a keypad mask to
+ * every machine, runs them all for K frames on the batch's worker threads, and writes the results straight
+ * into buffers the caller owns, so the cost of crossing the API is paid once per batch, not per machine.
+ *
+ * Frames are written one bit per pixel, 32 rows of uint64_t per machine with the leftmost pixel in the most
+ * significant bit (the same layout as PackedFrame), back to back: machine i starts at frames[i * 32].
+ *
+ * The reward for a step is how much a byte the game keeps its score in changed during the step, either a
+ * register or a memory address (see chip8_batch_set_reward). Nothing is reported until it is configured.
+ *
+ * All functions return CHIP8_OK or a negative CHIP8_ERROR_* code unless stated otherwise. A batch must not be
+ * used from two threads at once.
+ *
+ * Build as a shared library:
+ *     g++ -std=c++17 -O2 -shared -fPIC -pthread Chip8Batch.cpp Chip8.cpp FusionPlan.cpp RomAnalyzer.cpp RomDatabase.cpp -o libchip8.so
+ *     (on Windows define CHIP8_BUILD_DLL when building the DLL and CHIP8_USE_DLL in code that uses it)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(CHIP8_BUILD_DLL)
+#define CHIP8_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(CHIP8_USE_DLL)
+#define CHIP8_API __declspec(dllimport)
+#else
+#define CHIP8_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define CHIP8_API_VERSION 1
+
+#define CHIP8_FRAME_ROWS 32     /* uint64_t per machine in the frame buffer */
+
+#define CHIP8_OK 0
+#define CHIP8_ERROR_ARGUMENT -1
+#define CHIP8_ERROR_NO_ROM -2
+
+#define CHIP8_REWARD_NONE 0
+#define CHIP8_REWARD_REGISTER 1     /* V[location] */
+#define CHIP8_REWARD_MEMORY 2       /* memory[location] */
+
+#define CHIP8_ALL_MACHINES 0xFFFFFFFFu
+
+
+typedef struct Chip8Batch Chip8Batch;
+
+
+/* CHIP8_API_VERSION of the library, check it against the header before use */
+CHIP8_API uint32_t chip8_api_version(void);
+
+/* threads = 0 picks one per core. Returns NULL if the batch can't be allocated. */
+CHIP8_API Chip8Batch* chip8_batch_create(uint32_t count, uint32_t threads);
+CHIP8_API void chip8_batch_destroy(Chip8Batch* batch);
+
+CHIP8_API uint32_t chip8_batch_count(Chip8Batch const* batch);
+
+/* Copies the ROM and resets every machine to it */
+CHIP8_API int chip8_batch_load_rom(Chip8Batch* batch, uint8_t const* data, size_t size);
+
+/* Puts one machine (or CHIP8_ALL_MACHINES) back to the start of the ROM, e.g. at the end of an episode */
+CHIP8_API int chip8_batch_reset(Chip8Batch* batch, uint32_t machine);
+
+/* Machine i draws random numbers from seed + i, applied now and on every reset */
+CHIP8_API int chip8_batch_seed(Chip8Batch* batch, uint32_t seed);
+
+/* Masks every memory access so arbitrary ROMs can't crash the host, applied now and on every reset */
+CHIP8_API int chip8_batch_set_hardened(Chip8Batch* batch, int enabled);
+
+CHIP8_API int chip8_batch_set_reward(Chip8Batch* batch, int source, uint16_t location);
+
+/*
+ * Holds keys[i] (bit n = key n) on machine i and runs every machine for `frames` frames.
+ * frames_out (count * CHIP8_FRAME_ROWS) and rewards_out (count) may be NULL when not needed. Frames are only
+ * packed for steps that ask for them, so skipping frames_out costs no more than running the machines directly.
+ */
+CHIP8_API int chip8_batch_step(Chip8Batch* batch, uint16_t const* keys, uint32_t frames,
+    uint64_t* frames_out, int32_t* rewards_out);
+
+
+#ifdef __cplusplus
+}
+#endif
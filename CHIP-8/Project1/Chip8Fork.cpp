@@ -0,0 +1,135 @@
+#include "Chip8Fork.h"
+#include <cstring>
+
+
+static_assert(Chip8Fork::PAGE_COUNT <= 16, "Chip8::dirtyPages has one bit per page");
+
+
+// The CPU block plus profile has to be the whole machine apart from memory and video, so a member added
+// anywhere else would be silently left out of every snapshot
+static_assert(offsetof(Chip8, tables) == 0, "nothing may come before the CPU state");
+static_assert(offsetof(Chip8, memory) + sizeof(Chip8::memory) == offsetof(Chip8, video), "nothing may sit between memory and video");
+static_assert(offsetof(Chip8, video) + sizeof(Chip8::video) == offsetof(Chip8, profile), "nothing may sit between video and profile");
+static_assert(sizeof(Chip8) - offsetof(Chip8, profile) - sizeof(RomProfile) < Chip8::CACHE_LINE_SIZE, "profile must be the last member");
+
+
+
+uint8_t Chip8Fork::ReadByte(uint16_t address) const
+{
+    address &= Chip8::MEMORY_MASK;
+
+    return pages[address >> Chip8::PAGE_SHIFT]->bytes[address & (PAGE_SIZE - 1)];
+}
+
+
+void Chip8Fork::Video(uint32_t* pixels) const
+{
+    frame->Unpack(pixels);
+}
+
+
+bool Chip8Fork::Empty() const
+{
+    return !frame;
+}
+
+
+
+void ForkRunner::Load(Chip8Fork const& state)
+{
+    for (unsigned int i = 0; i < Chip8Fork::PAGE_COUNT; ++i)
+    {
+        bool dirty = (chip8.dirtyPages >> i) & 1u;
+
+        if (dirty || loaded.pages[i] != state.pages[i])
+        {
+            memcpy(&chip8.memory[i * Chip8Fork::PAGE_SIZE], state.pages[i]->bytes, Chip8Fork::PAGE_SIZE);
+            ++pagesCopied;
+        }
+    }
+
+    // Rows drawn on since the last Load/Capture, or different in the new snapshot
+    for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+    {
+        bool dirty = (chip8.videoDirtyRows >> y) & 1u;
+
+        if (dirty || !loaded.frame || loaded.frame->rows[y] != state.frame->rows[y])
+        {
+            PackedFrame::ExpandRow(state.frame->rows[y], &chip8.video[y * Chip8::VIDEO_WIDTH]);
+        }
+    }
+
+    memcpy(reinterpret_cast<uint8_t*>(&chip8), state.cpu, Chip8Fork::CPU_BYTES);
+    chip8.profile = state.profile;
+
+    chip8.dirtyPages = 0;
+    chip8.videoDirtyRows = 0;
+    chip8.videoDirtyBands = 0;
+
+    loaded = state;
+}
+
+
+Chip8Fork ForkRunner::Capture()
+{
+    Chip8Fork state;
+
+    memcpy(state.cpu, reinterpret_cast<uint8_t const*>(&chip8), Chip8Fork::CPU_BYTES);
+    state.profile = chip8.profile;
+
+    for (unsigned int i = 0; i < Chip8Fork::PAGE_COUNT; ++i)
+    {
+        bool dirty = (chip8.dirtyPages >> i) & 1u;
+
+        if (dirty || !loaded.pages[i])
+        {
+            auto page = std::make_shared<Chip8Fork::Page>();
+            memcpy(page->bytes, &chip8.memory[i * Chip8Fork::PAGE_SIZE], Chip8Fork::PAGE_SIZE);
+            state.pages[i] = std::move(page);
+            ++pagesAllocated;
+        }
+        else
+        {
+            state.pages[i] = loaded.pages[i];
+        }
+    }
+
+    // The frame stays shared until something draws, then only the rows drawn on are packed again
+    if (chip8.videoDirtyRows != 0 || !loaded.frame)
+    {
+        auto frame = std::make_shared<PackedFrame>();
+
+        for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+        {
+            bool dirty = (chip8.videoDirtyRows >> y) & 1u;
+
+            frame->rows[y] = (dirty || !loaded.frame) ? PackedFrame::PackRow(&chip8.video[y * Chip8::VIDEO_WIDTH]) : loaded.frame->rows[y];
+        }
+
+        state.frame = std::move(frame);
+    }
+    else
+    {
+        state.frame = loaded.frame;
+    }
+
+    chip8.dirtyPages = 0;
+    chip8.videoDirtyRows = 0;
+    chip8.videoDirtyBands = 0;
+
+    loaded = state;
+
+    return state;
+}
+
+
+uint64_t ForkRunner::PagesCopied() const
+{
+    return pagesCopied;
+}
+
+
+uint64_t ForkRunner::PagesAllocated() const
+{
+    return pagesAllocated;
+}
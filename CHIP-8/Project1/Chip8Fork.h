@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Chip8.h"
+#include "PackedFrame.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+// Snapshot of a machine for tree search. Memory is kept in 256-byte pages and the display in one 1bpp frame
+// (256 bytes instead of the machine's 8 KB of pixels), both shared (read-only) with every other snapshot that
+// has the same contents, so copying a Chip8Fork is the fork: two cache lines of CPU state plus 17 reference
+// counts, no matter how big the machine is.
+//
+// Snapshots never change: only a ForkRunner makes and restores them, everything else can only read them.
+class Chip8Fork
+{
+public:
+    const static unsigned int PAGE_SIZE = 1u << Chip8::PAGE_SHIFT;
+    const static unsigned int PAGE_COUNT = sizeof(Chip8::memory) / PAGE_SIZE;
+
+    // Everything in Chip8 before memory, copied as one block (the dirty bits come along, every Load and
+    // Capture clears them anyway)
+    const static size_t CPU_BYTES = offsetof(Chip8, memory);
+
+    struct Page
+    {
+        uint8_t bytes[PAGE_SIZE];
+    };
+
+    // Reads straight from the shared pages and frame, no runner needed
+    uint8_t ReadByte(uint16_t address) const;
+    void Video(uint32_t* pixels) const;     // Expanded to VIDEO_WIDTH * VIDEO_HEIGHT pixels like Chip8::video
+
+    bool Empty() const;
+
+private:
+    friend class ForkRunner;
+
+    uint8_t cpu[CPU_BYTES]{};
+    RomProfile profile{};
+    std::shared_ptr<Page const> pages[PAGE_COUNT];
+    std::shared_ptr<PackedFrame const> frame;
+};
+
+
+// Runs forks. Load() puts a snapshot into the machine, run it as usual, then Capture() a child snapshot.
+// The runner remembers which snapshot its machine came from and uses Chip8's dirty tracking to touch only
+// what changed: Capture() allocates just the pages written since the last Load/Capture (sharing the rest),
+// and Load() copies just the pages (and expands just the display rows) that differ from what the machine
+// already holds.
+//
+// Anything that writes chip8.memory or chip8.video outside the instruction handlers, Reset and LoadROM
+// has to call chip8.MarkWritten() / MarkDrawn(), or the write may be lost from the next snapshot.
+class ForkRunner
+{
+public:
+    Chip8 chip8;
+
+    void Load(Chip8Fork const& state);
+    Chip8Fork Capture();
+
+    // Page copies made by Load and pages allocated by Capture so far, to see how much is actually shared
+    uint64_t PagesCopied() const;
+    uint64_t PagesAllocated() const;
+
+private:
+    Chip8Fork loaded;       // Snapshot the machine matches, except for the pages and frame marked dirty
+    uint64_t pagesCopied = 0;
+    uint64_t pagesAllocated = 0;
+};
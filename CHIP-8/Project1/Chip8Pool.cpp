@@ -0,0 +1,81 @@
+#include "Chip8Pool.h"
+
+
+Chip8Pool::Chip8Pool(size_t blockSize) : blockSize(blockSize > 0 ? blockSize : 1)
+{
+}
+
+
+Chip8* Chip8Pool::Acquire()
+{
+    Chip8* chip8;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (freeList.empty())
+        {
+            Grow();
+        }
+
+        chip8 = freeList.back();
+        freeList.pop_back();
+    }
+
+    // Reset outside the lock, it's the expensive part (12 KB of memset)
+    chip8->Reset();
+
+    return chip8;
+}
+
+
+void Chip8Pool::Release(Chip8* chip8)
+{
+    if (chip8 == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    freeList.push_back(chip8);
+}
+
+
+void Chip8Pool::Reserve(size_t count)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    while (blocks.size() * blockSize < count)
+    {
+        Grow();
+    }
+}
+
+
+size_t Chip8Pool::Capacity() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return blocks.size() * blockSize;
+}
+
+
+size_t Chip8Pool::InUse() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return blocks.size() * blockSize - freeList.size();
+}
+
+
+// Caller holds the lock
+void Chip8Pool::Grow()
+{
+    blocks.emplace_back(new Chip8[blockSize]);
+
+    Chip8* block = blocks.back().get();
+
+    // Push in reverse so Acquire() hands out the block front to back
+    for (size_t i = blockSize; i > 0; --i)
+    {
+        freeList.push_back(&block[i - 1]);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// Hands out Chip8 machines for sessions and takes them back when the session ends.
+// Machines are allocated in blocks and recycled with Chip8::Reset() instead of being destroyed and
+// constructed again, so starting a session is a free-list pop plus a memset.
+class Chip8Pool
+{
+public:
+    const static size_t DEFAULT_BLOCK_SIZE = 256;     // Machines allocated at a time when the free list runs dry
+
+    explicit Chip8Pool(size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+    Chip8Pool(Chip8Pool const&) = delete;
+    Chip8Pool& operator=(Chip8Pool const&) = delete;
+
+    // Returns a machine in its power-on state (normal dispatch, nothing loaded)
+    Chip8* Acquire();
+
+    // Gives a machine from Acquire() back to the pool, it must not be used afterwards
+    void Release(Chip8* chip8);
+
+    // Allocates up front so the first sessions don't pay for it
+    void Reserve(size_t count);
+
+    size_t Capacity() const;
+    size_t InUse() const;
+
+private:
+    void Grow();
+
+    size_t blockSize;
+    std::vector<std::unique_ptr<Chip8[]>> blocks;
+    std::vector<Chip8*> freeList;
+    mutable std::mutex lock;
+};
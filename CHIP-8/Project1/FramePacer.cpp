@@ -0,0 +1,184 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+
+// Locked frames in a row that have to come back in under half a period before vsync is considered broken
+const static unsigned int SHORT_FRAME_LIMIT = 30;
+
+
+
+FramePacer::FramePacer(double frameHz) : period(1000000.0 / frameHz)
+{
+}
+
+
+unsigned int FramePacer::LockedInterval(double refreshHz, double frameHz)
+{
+    if (refreshHz <= 0.0)
+    {
+        return 0;
+    }
+
+    double interval = std::round(refreshHz / frameHz);
+
+    if (interval < 1.0 || std::fabs(refreshHz / interval - frameHz) > frameHz * 0.01)
+    {
+        return 0;
+    }
+
+    return static_cast<unsigned int>(interval);
+}
+
+
+void FramePacer::SetDisplay(double refreshHz, unsigned int vsyncInterval)
+{
+    this->refreshHz = refreshHz;
+    this->vsyncInterval = vsyncInterval;
+    shortFrames = 0;
+    deadline = Clock::time_point();
+}
+
+
+void FramePacer::WaitForPresent()
+{
+    if (vsyncInterval > 0)
+    {
+        // The present call does the waiting
+        return;
+    }
+
+    auto now = Clock::now();
+    auto step = std::chrono::duration_cast<Clock::duration>(period);
+
+    if (deadline == Clock::time_point())
+    {
+        deadline = now;
+    }
+    else
+    {
+        deadline += step;
+    }
+
+    // More than a frame behind (a stall, the window being dragged): start again from now rather than
+    // presenting a burst of frames to catch up
+    if (now > deadline + step)
+    {
+        deadline = now;
+    }
+
+    auto presentAt = deadline - std::chrono::duration_cast<Clock::duration>(Micros(presentEstimate));
+    auto wakeAt = presentAt - std::chrono::duration_cast<Clock::duration>(Micros(sleepMargin));
+
+    if (now < wakeAt)
+    {
+        std::this_thread::sleep_until(wakeAt);
+        Track(sleepMargin, Micros(Clock::now() - wakeAt).count());
+    }
+
+    // The last stretch is too short to trust to the scheduler
+    while (Clock::now() < presentAt)
+    {
+        std::this_thread::yield();
+    }
+}
+
+
+void FramePacer::PresentStarted()
+{
+    presentStart = Clock::now();
+}
+
+
+void FramePacer::PresentFinished()
+{
+    auto now = Clock::now();
+    double presentMicros = Micros(now - presentStart).count();
+
+    Track(presentEstimate, presentMicros);
+    ++frames;
+
+    if (!started)
+    {
+        started = true;
+        lastPresent = now;
+        return;
+    }
+
+    double frameMicros = Micros(now - lastPresent).count();
+    lastPresent = now;
+
+    frameTimes[next] = frameMicros;
+    presentTimes[next] = presentMicros;
+    next = (next + 1) % STATS_WINDOW;
+    samples = std::min(samples + 1, STATS_WINDOW);
+
+    if (frameMicros > period.count() * 1.5)
+    {
+        ++missedDeadlines;
+    }
+
+    if (vsyncInterval > 0)
+    {
+        shortFrames = (frameMicros < period.count() * 0.5) ? shortFrames + 1 : 0;
+
+        if (shortFrames >= SHORT_FRAME_LIMIT)
+        {
+            SetDisplay(refreshHz, 0);
+        }
+    }
+}
+
+
+FramePacerStats FramePacer::Stats() const
+{
+    FramePacerStats stats{};
+
+    stats.refreshHz = refreshHz;
+    stats.vsyncInterval = vsyncInterval;
+    stats.frameP50Millis = Percentile(frameTimes, samples, 0.50) / 1000.0;
+    stats.frameP99Millis = Percentile(frameTimes, samples, 0.99) / 1000.0;
+    stats.presentP50Millis = Percentile(presentTimes, samples, 0.50) / 1000.0;
+    stats.presentP99Millis = Percentile(presentTimes, samples, 0.99) / 1000.0;
+    stats.sleepMarginMillis = sleepMargin / 1000.0;
+    stats.frames = frames;
+    stats.missedDeadlines = missedDeadlines;
+
+    return stats;
+}
+
+
+// Slowly decaying maximum: jumps straight up to a worse sample, drifts back down over ~64 better ones.
+// Capped at half a period so one huge stall can't make the pacer stop sleeping.
+void FramePacer::Track(double& estimate, double sample) const
+{
+    if (sample > estimate)
+    {
+        estimate = sample;
+    }
+    else
+    {
+        estimate += (sample - estimate) / 64.0;
+    }
+
+    estimate = std::min(estimate, period.count() / 2.0);
+}
+
+
+double FramePacer::Percentile(double const* samples, unsigned int count, double fraction)
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+
+    double sorted[STATS_WINDOW];
+    memcpy(sorted, samples, count * sizeof(double));
+
+    unsigned int rank = std::min(count - 1, static_cast<unsigned int>(fraction * count));
+    std::nth_element(sorted, sorted + rank, sorted + count);
+
+    return sorted[rank];
+}
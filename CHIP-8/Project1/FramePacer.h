@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+
+// Frame timing over the last FramePacer::STATS_WINDOW frames, in milliseconds
+struct FramePacerStats
+{
+    double refreshHz;               // Display refresh rate, 0 when the display doesn't report one
+    unsigned int vsyncInterval;     // Refreshes per frame while locked to vsync, 0 while paced by the timer
+    double frameP50Millis;          // Present to present
+    double frameP99Millis;
+    double presentP50Millis;        // Time spent inside the present call
+    double presentP99Millis;
+    double sleepMarginMillis;       // How early the pacer wakes up to absorb oversleep
+    uint64_t frames;                // Totals since the pacer was made
+    uint64_t missedDeadlines;       // Frames that stayed on screen for longer than 1.5 frame periods
+};
+
+
+// Decides when each frame is presented.
+//
+// When the display refreshes at a whole multiple of the frame rate (60 Hz, 120 Hz, 240 Hz) and vsync is on,
+// presentation is locked to vsync: the present call blocks until the right refresh and nothing else waits.
+// Otherwise frames are paced by the timer against fixed deadlines. The pacer sleeps until shortly before a
+// deadline, then yields until it is time to present. How early it wakes adapts to how long sleeps overshoot
+// and how long the present call takes, both tracked as slowly decaying maxima.
+//
+// If a locked display turns out not to block (minimized window, driver ignoring vsync) the pacer drops back
+// to timer pacing instead of spinning.
+//
+//     WaitForPresent();
+//     PresentStarted();
+//     ...present...
+//     PresentFinished();
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    const static unsigned int STATS_WINDOW = 600;      // 10 seconds at 60 Hz
+
+    explicit FramePacer(double frameHz = 60.0);
+
+    // Refreshes per frame if refreshHz is a whole multiple of frameHz (within 1%), 0 if it isn't or is unknown
+    static unsigned int LockedInterval(double refreshHz, double frameHz = 60.0);
+
+    // What the renderer ended up with: vsyncInterval > 0 locks presentation to vsync, 0 paces by the timer
+    void SetDisplay(double refreshHz, unsigned int vsyncInterval);
+
+    void WaitForPresent();
+    void PresentStarted();
+    void PresentFinished();
+
+    FramePacerStats Stats() const;
+
+private:
+    typedef std::chrono::duration<double, std::micro> Micros;
+
+    void Track(double& estimate, double sample) const;
+    static double Percentile(double const* samples, unsigned int count, double fraction);
+
+    Micros period;
+    double refreshHz = 0.0;
+    unsigned int vsyncInterval = 0;
+    unsigned int shortFrames = 0;       // Locked frames in a row that came back far too early
+
+    Clock::time_point deadline;         // When the current frame should be on screen (timer pacing)
+    Clock::time_point presentStart;
+    Clock::time_point lastPresent;
+    bool started = false;
+
+    double sleepMargin = 0.0;           // Micros
+    double presentEstimate = 0.0;       // Micros
+
+    double frameTimes[STATS_WINDOW]{};
+    double presentTimes[STATS_WINDOW]{};
+    unsigned int samples = 0;           // Valid entries in the windows
+    unsigned int next = 0;              // Slot the next sample goes in
+    uint64_t frames = 0;
+    uint64_t missedDeadlines = 0;
+};
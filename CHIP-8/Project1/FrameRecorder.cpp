@@ -0,0 +1,673 @@
+#include "FrameRecorder.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string.h>
+
+
+const static uint16_t FORMAT_VERSION = 1;
+const static size_t HEADER_SIZE = 16;
+const static size_t TRAILER_SIZE = 12;      // u64 index offset + magic
+
+const static uint8_t RECORD_KEYFRAME = 'K';
+const static uint8_t RECORD_DELTA = 'D';
+const static uint8_t RECORD_REPEAT = 'R';
+const static uint8_t RECORD_INDEX = 'I';
+
+const static size_t FRAME_BYTES = sizeof(PackedFrame);
+const static size_t ROW_BYTES = FRAME_BYTES / Chip8::VIDEO_HEIGHT;
+
+
+
+static void PutU16(std::vector<uint8_t>& out, uint16_t value)
+{
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8u));
+}
+
+
+static void PutU32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        out.push_back(static_cast<uint8_t>(value >> (8u * i)));
+    }
+}
+
+
+static void PutU64(std::vector<uint8_t>& out, uint64_t value)
+{
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        out.push_back(static_cast<uint8_t>(value >> (8u * i)));
+    }
+}
+
+
+static void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80u)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80u));
+        value >>= 7u;
+    }
+
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+
+// Appends a size-prefixed run-length encoding of a frame's bytes
+static void PutRle(std::vector<uint8_t>& out, uint8_t const* bytes)
+{
+    uint8_t encoded[FRAME_BYTES * 2];
+    size_t size = 0;
+    size_t i = 0;
+
+    while (i < FRAME_BYTES)
+    {
+        size_t run = 0;
+
+        if (bytes[i] == 0)
+        {
+            while (i + run < FRAME_BYTES && run < 128 && bytes[i + run] == 0)
+            {
+                ++run;
+            }
+
+            encoded[size++] = static_cast<uint8_t>(run - 1);
+        }
+        else
+        {
+            while (i + run < FRAME_BYTES && run < 128 && bytes[i + run] != 0)
+            {
+                ++run;
+            }
+
+            encoded[size++] = static_cast<uint8_t>(0x80u | (run - 1));
+            memcpy(&encoded[size], &bytes[i], run);
+            size += run;
+        }
+
+        i += run;
+    }
+
+    PutVarint(out, size);
+    out.insert(out.end(), encoded, encoded + size);
+}
+
+
+// Stored a column of bytes at a time (the 8 pixel wide column at the left edge for all 32 rows, then the next
+// one), so the rows of a sprite land next to each other and its change encodes as one run instead of one per row
+static void Serialize(PackedFrame const& frame, uint8_t* bytes)
+{
+    for (unsigned int i = 0; i < ROW_BYTES; ++i)
+    {
+        for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+        {
+            bytes[i * Chip8::VIDEO_HEIGHT + y] = static_cast<uint8_t>(frame.rows[y] >> (56u - 8u * i));
+        }
+    }
+}
+
+
+static void Deserialize(uint8_t const* bytes, PackedFrame& frame)
+{
+    for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+    {
+        uint64_t row = 0;
+
+        for (unsigned int i = 0; i < ROW_BYTES; ++i)
+        {
+            row = (row << 8u) | bytes[i * Chip8::VIDEO_HEIGHT + y];
+        }
+
+        frame.rows[y] = row;
+    }
+}
+
+
+
+// ------- RECORDER --------
+
+FrameRecorder::FrameRecorder(char const* filename, unsigned int keyframeInterval)
+    : keyframeInterval(std::max(1u, keyframeInterval))
+{
+    file = std::fopen(filename, "wb");
+
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    staging.reserve(HANDOFF_BYTES * 2);
+
+    staging.insert(staging.end(), { 'C', '8', 'V', 'C' });
+    PutU16(staging, FORMAT_VERSION);
+    staging.push_back(static_cast<uint8_t>(Chip8::VIDEO_WIDTH));
+    staging.push_back(static_cast<uint8_t>(Chip8::VIDEO_HEIGHT));
+    PutU32(staging, this->keyframeInterval);
+    PutU32(staging, 0);
+
+    writer = std::thread(&FrameRecorder::WriterLoop, this);
+}
+
+
+FrameRecorder::~FrameRecorder()
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    FlushRepeats();
+
+    // Index of every keyframe, then where the index starts so a reader can find it from the end
+    uint64_t indexOffset = Bytes();
+
+    staging.push_back(RECORD_INDEX);
+    PutU32(staging, static_cast<uint32_t>(frames));
+    PutU32(staging, static_cast<uint32_t>(keyframes.size()));
+
+    for (auto const& keyframe : keyframes)
+    {
+        PutU32(staging, keyframe.first);
+        PutU64(staging, keyframe.second);
+    }
+
+    PutU64(staging, indexOffset);
+    staging.insert(staging.end(), { 'C', '8', 'I', 'X' });
+
+    HandOff();
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+
+    wake.notify_one();
+    writer.join();
+
+    std::fclose(file);
+}
+
+
+bool FrameRecorder::IsOpen() const
+{
+    return file != nullptr;
+}
+
+
+void FrameRecorder::Record(Chip8 const& chip8)
+{
+    PackedFrame frame;
+
+    for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+    {
+        uint32_t const* pixel = &chip8.video[y * Chip8::VIDEO_WIDTH];
+        uint64_t row = 0;
+
+        for (unsigned int x = 0; x < Chip8::VIDEO_WIDTH; ++x)
+        {
+            row = (row << 1u) | (pixel[x] & 0x1u);
+        }
+
+        frame.rows[y] = row;
+    }
+
+    Record(frame);
+}
+
+
+void FrameRecorder::Record(PackedFrame const& frame)
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    uint8_t bytes[FRAME_BYTES];
+    Serialize(frame, bytes);
+
+    if (frames % keyframeInterval == 0)
+    {
+        FlushRepeats();
+
+        keyframes.emplace_back(static_cast<uint32_t>(frames), Bytes());
+
+        staging.push_back(RECORD_KEYFRAME);
+        PutU32(staging, static_cast<uint32_t>(frames));
+        PutRle(staging, bytes);
+    }
+    else if (memcmp(bytes, previous, FRAME_BYTES) == 0)
+    {
+        ++repeats;
+    }
+    else
+    {
+        FlushRepeats();
+
+        uint8_t delta[FRAME_BYTES];
+
+        for (size_t i = 0; i < FRAME_BYTES; ++i)
+        {
+            delta[i] = bytes[i] ^ previous[i];
+        }
+
+        staging.push_back(RECORD_DELTA);
+        PutRle(staging, delta);
+    }
+
+    memcpy(previous, bytes, FRAME_BYTES);
+    ++frames;
+
+    if (++framesSinceHandOff >= HANDOFF_FRAMES || staging.size() >= HANDOFF_BYTES)
+    {
+        HandOff();
+    }
+}
+
+
+uint64_t FrameRecorder::Frames() const
+{
+    return frames;
+}
+
+
+uint64_t FrameRecorder::Bytes() const
+{
+    return handedOff + staging.size();
+}
+
+
+void FrameRecorder::FlushRepeats()
+{
+    if (repeats > 0)
+    {
+        staging.push_back(RECORD_REPEAT);
+        PutVarint(staging, repeats);
+        repeats = 0;
+    }
+}
+
+
+// Gives the staged bytes to the writer. The writer swaps them out under the lock, so this only ever
+// appends to a buffer that already has room.
+void FrameRecorder::HandOff()
+{
+    framesSinceHandOff = 0;
+
+    if (staging.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending.insert(pending.end(), staging.begin(), staging.end());
+    }
+
+    handedOff += staging.size();
+    staging.clear();
+
+    wake.notify_one();
+}
+
+
+void FrameRecorder::WriterLoop()
+{
+    std::vector<uint8_t> writing;
+
+    while (true)
+    {
+        bool stop;
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || !pending.empty(); });
+
+            writing.swap(pending);
+            stop = stopping;
+        }
+
+        if (!writing.empty())
+        {
+            std::fwrite(writing.data(), 1, writing.size(), file);
+            std::fflush(file);
+            writing.clear();
+        }
+
+        if (stop)
+        {
+            return;
+        }
+    }
+}
+
+
+
+// ------- READER --------
+
+// Bounds-checked reading from the loaded file, every read fails once anything has run past the end
+struct Cursor
+{
+    std::vector<uint8_t> const& data;
+    size_t position;
+    size_t end;
+    bool ok = true;
+
+    uint8_t Byte()
+    {
+        if (position >= end)
+        {
+            ok = false;
+            return 0;
+        }
+
+        return data[position++];
+    }
+
+    uint64_t Fixed(unsigned int bytes)
+    {
+        uint64_t value = 0;
+
+        for (unsigned int i = 0; i < bytes; ++i)
+        {
+            value |= static_cast<uint64_t>(Byte()) << (8u * i);
+        }
+
+        return value;
+    }
+
+    uint64_t Varint()
+    {
+        uint64_t value = 0;
+
+        for (unsigned int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = Byte();
+            value |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+
+            if ((byte & 0x80u) == 0)
+            {
+                return value;
+            }
+        }
+
+        ok = false;
+        return 0;
+    }
+
+    // Decodes one size-prefixed RLE block into out (overwriting or XORing), fails unless it is exactly a frame
+    void Rle(uint8_t* out, bool xorInto)
+    {
+        uint64_t size = Varint();
+
+        if (!ok || size > end - position)
+        {
+            ok = false;
+            return;
+        }
+
+        size_t blockEnd = position + static_cast<size_t>(size);
+        size_t written = 0;
+
+        while (ok && position < blockEnd)
+        {
+            uint8_t token = data[position++];
+            size_t run = (token & 0x7Fu) + 1u;
+
+            if (written + run > FRAME_BYTES || ((token & 0x80u) != 0 && run > blockEnd - position))
+            {
+                ok = false;
+                return;
+            }
+
+            for (size_t i = 0; i < run; ++i)
+            {
+                uint8_t value = (token & 0x80u) ? data[position++] : 0;
+                out[written + i] = xorInto ? (out[written + i] ^ value) : value;
+            }
+
+            written += run;
+        }
+
+        ok = ok && written == FRAME_BYTES;
+    }
+
+    void Skip(uint64_t bytes)
+    {
+        if (bytes > end - position)
+        {
+            ok = false;
+            return;
+        }
+
+        position += static_cast<size_t>(bytes);
+    }
+};
+
+
+
+bool FrameReader::Open(char const* filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (data.size() < HEADER_SIZE || memcmp(data.data(), "C8VC", 4) != 0)
+    {
+        return false;
+    }
+
+    Cursor header{ data, 4, HEADER_SIZE };
+
+    if (header.Fixed(2) != FORMAT_VERSION || header.Byte() != Chip8::VIDEO_WIDTH || header.Byte() != Chip8::VIDEO_HEIGHT)
+    {
+        return false;
+    }
+
+    if (!ReadIndex())
+    {
+        ScanIndex();
+    }
+
+    return Seek(0) || frameCount == 0;
+}
+
+
+uint32_t FrameReader::FrameCount() const
+{
+    return frameCount;
+}
+
+
+bool FrameReader::ReadIndex()
+{
+    if (data.size() < HEADER_SIZE + TRAILER_SIZE || memcmp(&data[data.size() - 4], "C8IX", 4) != 0)
+    {
+        return false;
+    }
+
+    Cursor trailer{ data, data.size() - TRAILER_SIZE, data.size() };
+    uint64_t indexOffset = trailer.Fixed(8);
+
+    if (indexOffset < HEADER_SIZE || indexOffset >= data.size() - TRAILER_SIZE)
+    {
+        return false;
+    }
+
+    Cursor index{ data, static_cast<size_t>(indexOffset), data.size() - TRAILER_SIZE };
+
+    if (index.Byte() != RECORD_INDEX)
+    {
+        return false;
+    }
+
+    uint32_t frames = static_cast<uint32_t>(index.Fixed(4));
+    uint32_t count = static_cast<uint32_t>(index.Fixed(4));
+
+    keyframes.clear();
+
+    for (uint32_t i = 0; i < count && index.ok; ++i)
+    {
+        uint32_t frame = static_cast<uint32_t>(index.Fixed(4));
+        uint64_t offset = index.Fixed(8);
+
+        if (offset < HEADER_SIZE || offset >= indexOffset)
+        {
+            return false;
+        }
+
+        keyframes.emplace_back(frame, offset);
+    }
+
+    if (!index.ok)
+    {
+        return false;
+    }
+
+    frameCount = frames;
+    end = static_cast<size_t>(indexOffset);
+
+    return true;
+}
+
+
+// No index (the recording was cut short): walk the records, keeping everything up to the first damaged one
+void FrameReader::ScanIndex()
+{
+    Cursor cursor{ data, HEADER_SIZE, data.size() };
+    uint32_t frames = 0;
+
+    keyframes.clear();
+    end = HEADER_SIZE;
+
+    while (cursor.position < data.size())
+    {
+        size_t start = cursor.position;
+        uint8_t type = cursor.Byte();
+
+        if (type == RECORD_KEYFRAME)
+        {
+            frames = static_cast<uint32_t>(cursor.Fixed(4));
+            cursor.Skip(cursor.Varint());
+
+            if (cursor.ok)
+            {
+                keyframes.emplace_back(frames, start);
+            }
+
+            ++frames;
+        }
+        else if (type == RECORD_DELTA)
+        {
+            cursor.Skip(cursor.Varint());
+            ++frames;
+        }
+        else if (type == RECORD_REPEAT)
+        {
+            frames += static_cast<uint32_t>(cursor.Varint());
+        }
+        else
+        {
+            break;
+        }
+
+        if (!cursor.ok)
+        {
+            break;
+        }
+
+        frameCount = frames;
+        end = cursor.position;
+    }
+}
+
+
+bool FrameReader::Seek(uint32_t frame)
+{
+    if (frame >= frameCount || keyframes.empty())
+    {
+        return false;
+    }
+
+    // Last keyframe at or before the frame
+    auto it = std::upper_bound(keyframes.begin(), keyframes.end(), frame,
+        [](uint32_t f, std::pair<uint32_t, uint64_t> const& keyframe) { return f < keyframe.first; });
+
+    if (it == keyframes.begin())
+    {
+        return false;
+    }
+
+    --it;
+
+    position = static_cast<size_t>(it->second);
+    frameNumber = it->first;
+    repeatsLeft = 0;
+    haveFrame = false;
+
+    PackedFrame skipped;
+
+    while (frameNumber < frame)
+    {
+        if (!Next(skipped))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool FrameReader::Next(PackedFrame& frame)
+{
+    if (repeatsLeft > 0)
+    {
+        --repeatsLeft;
+    }
+    else
+    {
+        Cursor cursor{ data, position, end };
+        uint8_t type = cursor.Byte();
+
+        if (type == RECORD_KEYFRAME)
+        {
+            frameNumber = static_cast<uint32_t>(cursor.Fixed(4));
+            cursor.Rle(current, false);
+            haveFrame = cursor.ok;
+        }
+        else if (type == RECORD_DELTA && haveFrame)
+        {
+            cursor.Rle(current, true);
+        }
+        else if (type == RECORD_REPEAT && haveFrame)
+        {
+            uint64_t count = cursor.Varint();
+            cursor.ok = cursor.ok && count > 0;
+            repeatsLeft = cursor.ok ? count - 1 : 0;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (!cursor.ok)
+        {
+            return false;
+        }
+
+        position = cursor.position;
+    }
+
+    Deserialize(current, frame);
+    ++frameNumber;
+
+    return true;
+}
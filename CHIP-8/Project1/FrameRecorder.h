@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Chip8.h"
+#include "PackedFrame.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Records the display, one frame per emulated 60 Hz frame, into a small streaming file. Frames are kept at one
+// bit per pixel (256 bytes, stored column by column of 8 pixel wide bytes). A frame that differs from the last
+// one is stored as the XOR with it, run-length encoded. A run of unchanged frames is stored as a single count.
+// Every keyframeInterval frames a full frame is stored instead, so playback can start there.
+//
+// The emulator thread only packs and encodes (a microsecond or so). The bytes are handed to a writer thread
+// about once a second, which does the actual file I/O.
+//
+// File layout, little endian, sizes as varints (LEB128):
+//
+//     header      "C8VC"  u16 version  u8 width  u8 height  u32 keyframe interval  u32 reserved
+//     'K' u32 frame  varint size  RLE(frame)          keyframe
+//     'D' varint size  RLE(frame XOR previous)         delta
+//     'R' varint count                                 previous frame shown count more times
+//     'I' u32 frames  u32 keyframes  { u32 frame  u64 offset } ...  u64 'I' offset  "C8IX"      index, written on close
+//
+// RLE tokens: 0nnnnnnn = n + 1 zero bytes, 1nnnnnnn = n + 1 literal bytes follow. A file cut short (crash) has
+// no index, FrameReader rebuilds it by scanning.
+class FrameRecorder
+{
+public:
+    const static unsigned int DEFAULT_KEYFRAME_INTERVAL = 600;      // 10 seconds at 60 Hz
+
+    explicit FrameRecorder(char const* filename, unsigned int keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+    ~FrameRecorder();
+
+    FrameRecorder(FrameRecorder const&) = delete;
+    FrameRecorder& operator=(FrameRecorder const&) = delete;
+
+    bool IsOpen() const;
+
+    // Call once per emulated frame
+    void Record(Chip8 const& chip8);
+    void Record(PackedFrame const& frame);
+
+    uint64_t Frames() const;
+    uint64_t Bytes() const;        // Encoded so far, including what the writer hasn't written yet
+
+private:
+    const static size_t HANDOFF_BYTES = 16384;         // Hand over sooner than once a second if this much is waiting
+    const static unsigned int HANDOFF_FRAMES = 60;
+
+    void FlushRepeats();
+    void HandOff();
+    void WriterLoop();
+
+    std::FILE* file = nullptr;
+    unsigned int keyframeInterval;
+
+    // ------- EMULATOR THREAD --------
+
+    uint8_t previous[sizeof(PackedFrame)]{};
+    uint64_t frames = 0;
+    uint64_t repeats = 0;           // Unchanged frames not written yet
+    uint64_t handedOff = 0;         // Bytes given to the writer, staging starts at this file offset
+    unsigned int framesSinceHandOff = 0;
+    std::vector<uint8_t> staging;
+    std::vector<std::pair<uint32_t, uint64_t>> keyframes;
+
+    // ------- SHARED WITH THE WRITER --------
+
+    std::vector<uint8_t> pending;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread writer;
+};
+
+
+// Plays back a FrameRecorder file. The whole file is read into memory, recordings are a few KB a minute.
+class FrameReader
+{
+public:
+    bool Open(char const* filename);
+
+    uint32_t FrameCount() const;
+
+    // Next call to Next() returns frame number `frame`, starting from the closest keyframe before it
+    bool Seek(uint32_t frame);
+
+    // Decodes the next frame, false at the end of the recording (or on a damaged record)
+    bool Next(PackedFrame& frame);
+
+private:
+    bool ReadIndex();
+    void ScanIndex();
+
+    std::vector<uint8_t> data;
+    std::vector<std::pair<uint32_t, uint64_t>> keyframes;
+    uint32_t frameCount = 0;
+    size_t end = 0;                 // Where the records stop (the index, or the end of the file)
+
+    size_t position = 0;
+    uint32_t frameNumber = 0;       // Number of the frame Next() returns
+    uint64_t repeatsLeft = 0;
+    bool haveFrame = false;
+    uint8_t current[sizeof(PackedFrame)]{};
+};
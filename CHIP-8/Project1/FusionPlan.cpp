@@ -0,0 +1,88 @@
+#include "FusionPlan.h"
+#include <string.h>
+
+
+static bool IsSkip(Chip8::Chip8Func handler)
+{
+    return handler == &Chip8::OP_3xkk || handler == &Chip8::OP_4xkk ||
+           handler == &Chip8::OP_5xy0 || handler == &Chip8::OP_9xy0 ||
+           handler == &Chip8::OP_Ex9E || handler == &Chip8::OP_ExA1;
+}
+
+
+unsigned int FusionPlan::MaxLength(Kind kind)
+{
+    switch (kind)
+    {
+        case IndexDraw: return 2;
+        case LoadDelay: return 2;
+        case CountLoop: return 3;
+        case SkipJump:  return 2;
+        default:        return 1;
+    }
+}
+
+
+bool FusionPlan::Build(Chip8 const& chip8, RomAnalysis const& analysis)
+{
+    memset(kinds, None, sizeof(kinds));
+
+    if (analysis.MayModifyCode() || !analysis.indirectJumps.empty())
+    {
+        return false;
+    }
+
+    for (unsigned int address = 0; address < 4096; ++address)
+    {
+        if (!analysis.instructionStart[address])
+        {
+            continue;
+        }
+
+        // Decode the same way Cycle() does. None of the first instructions branch, so the ones after them
+        // are always the next ones in memory (and reachable code, which the analysis says is never written).
+        uint16_t first = chip8.PeekOpcode(address);
+        uint16_t second = chip8.PeekOpcode(address + 2u);
+        uint16_t third = chip8.PeekOpcode(address + 4u);
+
+        Chip8::Chip8Func firstHandler = Chip8::Decode(first);
+        Chip8::Chip8Func secondHandler = Chip8::Decode(second);
+        Chip8::Chip8Func thirdHandler = Chip8::Decode(third);
+
+        Kind kind = None;
+
+        if (firstHandler == &Chip8::OP_Annn && secondHandler == &Chip8::OP_Dxyn)
+        {
+            kind = IndexDraw;
+        }
+        else if (firstHandler == &Chip8::OP_6xkk && secondHandler == &Chip8::OP_Fx15)
+        {
+            kind = LoadDelay;
+        }
+        else if (firstHandler == &Chip8::OP_7xkk && secondHandler == &Chip8::OP_3xkk && thirdHandler == &Chip8::OP_1nnn)
+        {
+            kind = CountLoop;
+        }
+        else if (IsSkip(firstHandler) && secondHandler == &Chip8::OP_1nnn)
+        {
+            kind = SkipJump;
+        }
+
+        kinds[address] = kind;
+    }
+
+    return true;
+}
+
+
+size_t FusionPlan::Count() const
+{
+    size_t count = 0;
+
+    for (uint8_t kind : kinds)
+    {
+        count += (kind != None);
+    }
+
+    return count;
+}
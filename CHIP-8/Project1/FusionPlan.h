@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Chip8.h"
+#include "RomAnalyzer.h"
+#include <cstddef>
+#include <cstdint>
+
+
+// Marks the addresses where a common instruction sequence starts so Chip8::Run() can execute the whole
+// sequence with one dispatch. Built once per ROM and shared read-only by every machine running it.
+//
+// Only ROMs that provably never write into their own code get a plan, otherwise a sequence could be
+// rewritten under it.
+class FusionPlan
+{
+public:
+    enum Kind : uint8_t
+    {
+        None,
+        IndexDraw,      // Annn, Dxyn
+        LoadDelay,      // 6xkk, Fx15
+        CountLoop,      // 7xkk, 3ykk, 1nnn
+        SkipJump        // 3xkk/4xkk/5xy0/9xy0/Ex9E/ExA1, 1nnn
+    };
+
+    // Most instructions a fused sequence can run, Run() only fuses when this many are left in the budget
+    static unsigned int MaxLength(Kind kind);
+
+    // Fills the plan from an analysis of the ROM loaded in chip8, returns false (plan left empty) when the
+    // ROM may modify its code or jumps somewhere the analysis couldn't follow
+    bool Build(Chip8 const& chip8, RomAnalysis const& analysis);
+
+    Kind At(uint16_t address) const
+    {
+        return static_cast<Kind>(kinds[address & Chip8::MEMORY_MASK]);
+    }
+
+    // Number of sequences found
+    size_t Count() const;
+
+private:
+    uint8_t kinds[4096]{};
+};
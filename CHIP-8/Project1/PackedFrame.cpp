@@ -0,0 +1,41 @@
+#include "PackedFrame.h"
+
+
+void PackedFrame::Pack(uint32_t const* pixels)
+{
+    for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+    {
+        rows[y] = PackRow(&pixels[y * Chip8::VIDEO_WIDTH]);
+    }
+}
+
+
+void PackedFrame::Unpack(uint32_t* pixels) const
+{
+    for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+    {
+        ExpandRow(rows[y], &pixels[y * Chip8::VIDEO_WIDTH]);
+    }
+}
+
+
+uint64_t PackedFrame::PackRow(uint32_t const* pixels)
+{
+    uint64_t row = 0;
+
+    for (unsigned int x = 0; x < Chip8::VIDEO_WIDTH; ++x)
+    {
+        row = (row << 1u) | (pixels[x] & 0x1u);
+    }
+
+    return row;
+}
+
+
+void PackedFrame::ExpandRow(uint64_t row, uint32_t* pixels)
+{
+    for (unsigned int x = 0; x < Chip8::VIDEO_WIDTH; ++x)
+    {
+        pixels[x] = ((row >> (63u - x)) & 0x1u) ? 0xFFFFFFFFu : 0x00000000u;
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstdint>
+
+
+// 64x32 frame at one bit per pixel, one row per word, leftmost pixel in the most significant bit. What the frame
+// channel, the recorder, forks and the batch interface pass around instead of the machine's 8 KB of pixels.
+struct PackedFrame
+{
+    uint64_t rows[Chip8::VIDEO_HEIGHT];
+
+    // From / to VIDEO_WIDTH * VIDEO_HEIGHT of the 0x00000000/0xFFFFFFFF pixels in Chip8::video
+    void Pack(uint32_t const* pixels);
+    void Unpack(uint32_t* pixels) const;
+
+    // One row of VIDEO_WIDTH pixels
+    static uint64_t PackRow(uint32_t const* pixels);
+    static void ExpandRow(uint64_t row, uint32_t* pixels);
+};
@@ -1,7 +1,31 @@
+
 #pragma once
 
+#include <cstdint>
+
+
+struct SDL_Window;
+struct SDL_Renderer;
+struct SDL_Texture;
+
 
 class Platform
 {
-};
+	private:
+		SDL_Window* window;
+		SDL_Renderer* renderer;
+		SDL_Texture* texture;
+		uint32_t* pixels;
+	public:
+		Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight);
+		~Platform();
+
+		void Update(void const* buffer, int pitch);
 
+		// Refresh rate of the display the window is on, 0 if it doesn't report one
+		double RefreshRate() const;
+
+		// Presents on every interval-th refresh (0 turns vsync off), false if the renderer can't
+		bool SetVSync(int interval);
+		bool ProcessInput(uint8_t* keys);
+};
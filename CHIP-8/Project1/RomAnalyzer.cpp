@@ -0,0 +1,348 @@
+#include "RomAnalyzer.h"
+#include <algorithm>
+#include <map>
+
+
+// What an instruction does to control flow
+enum class Flow
+{
+    Next,
+    Jump,
+    Call,
+    Return,
+    Skip,
+    Indirect
+};
+
+
+// What the analysis knows about I at some point, Unvisited until a path reaches it
+struct IndexState
+{
+    enum Kind : uint8_t { Unvisited, Known, Unknown };
+
+    Kind kind;
+    uint16_t value;
+
+    bool operator==(IndexState const& other) const
+    {
+        return kind == other.kind && (kind != Known || value == other.value);
+    }
+
+    // Combines the states of two paths meeting at the same block
+    static IndexState Meet(IndexState a, IndexState b)
+    {
+        if (a.kind == Unvisited) return b;
+        if (b.kind == Unvisited) return a;
+        if (a == b) return a;
+
+        return { Unknown, 0 };
+    }
+};
+
+
+
+static uint16_t NextAddress(uint16_t address, unsigned int instructions = 1)
+{
+    return (address + 2u * instructions) & Chip8::MEMORY_MASK;
+}
+
+
+static Flow Classify(uint16_t opcode)
+{
+    Chip8::Chip8Func handler = Chip8::Decode(opcode);
+
+    if (handler == &Chip8::OP_1nnn) return Flow::Jump;
+    if (handler == &Chip8::OP_2nnn) return Flow::Call;
+    if (handler == &Chip8::OP_00EE) return Flow::Return;
+    if (handler == &Chip8::OP_Bnnn) return Flow::Indirect;
+
+    if (handler == &Chip8::OP_3xkk || handler == &Chip8::OP_4xkk ||
+        handler == &Chip8::OP_5xy0 || handler == &Chip8::OP_9xy0 ||
+        handler == &Chip8::OP_Ex9E || handler == &Chip8::OP_ExA1)
+    {
+        return Flow::Skip;
+    }
+
+    // Everything else, including opcodes the core ignores (OP_NULL), just moves on to the next instruction
+    return Flow::Next;
+}
+
+
+// Applies one instruction's effect on I
+static IndexState StepIndex(IndexState state, uint16_t opcode)
+{
+    Chip8::Chip8Func handler = Chip8::Decode(opcode);
+
+    if (handler == &Chip8::OP_Annn)
+    {
+        return { IndexState::Known, static_cast<uint16_t>(opcode & 0x0FFFu) };
+    }
+    if (handler == &Chip8::OP_Fx29 || handler == &Chip8::OP_Fx1E)
+    {
+        // Depends on a register. Fx29 isn't confined to the font either: Vx up to 0xFF puts I anywhere up to
+        // FONTSET_START_ADDRESS + 5 * 0xFF, well into the program.
+        return { IndexState::Unknown, 0 };
+    }
+
+    return state;
+}
+
+
+// Number of bytes an Fx33/Fx55 writes starting at I, 0 for anything else
+static unsigned int WriteLength(uint16_t opcode)
+{
+    Chip8::Chip8Func handler = Chip8::Decode(opcode);
+
+    if (handler == &Chip8::OP_Fx33) return 3;
+    if (handler == &Chip8::OP_Fx55) return ((opcode & 0x0F00u) >> 8u) + 1;
+
+    return 0;
+}
+
+
+
+BasicBlock const* RomAnalysis::FindBlock(uint16_t address) const
+{
+    // Last block starting at or before address
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), address,
+        [](uint16_t a, BasicBlock const& block) { return a < block.start; });
+
+    if (it == blocks.begin())
+    {
+        return nullptr;
+    }
+
+    --it;
+
+    // Blocks may wrap past 0xFFF, compare the distance from the start instead of the raw addresses
+    uint16_t offset = (address - it->start) & Chip8::MEMORY_MASK;
+    uint16_t length = (it->end - it->start) & Chip8::MEMORY_MASK;
+
+    return (offset < length && instructionStart[address]) ? &*it : nullptr;
+}
+
+
+
+RomAnalysis RomAnalyzer::Analyze(Chip8 const& chip8, uint16_t entry)
+{
+    RomAnalysis analysis;
+    std::bitset<4096> leaders;
+
+    entry &= Chip8::MEMORY_MASK;
+
+
+    // 1. Find every reachable instruction and every address a block has to start at
+
+    std::vector<uint16_t> work = { entry };
+    leaders.set(entry);
+
+    auto branchTo = [&](uint16_t target)
+    {
+        leaders.set(target);
+        work.push_back(target);
+    };
+
+    while (!work.empty())
+    {
+        uint16_t address = work.back();
+        work.pop_back();
+
+        while (true)
+        {
+            if (analysis.instructionStart[address])
+            {
+                // Ran into code another path already walked, it has to start a block
+                leaders.set(address);
+                break;
+            }
+
+            analysis.instructionStart.set(address);
+            analysis.code.set(address);
+            analysis.code.set((address + 1u) & Chip8::MEMORY_MASK);
+
+            uint16_t opcode = chip8.PeekOpcode(address);
+            Flow flow = Classify(opcode);
+
+            if (flow == Flow::Next)
+            {
+                address = NextAddress(address);
+                continue;
+            }
+
+            if (flow == Flow::Jump)
+            {
+                branchTo(opcode & 0x0FFFu);
+            }
+            else if (flow == Flow::Call)
+            {
+                branchTo(opcode & 0x0FFFu);
+                branchTo(NextAddress(address));
+            }
+            else if (flow == Flow::Skip)
+            {
+                branchTo(NextAddress(address));
+                branchTo(NextAddress(address, 2));
+            }
+            else if (flow == Flow::Indirect)
+            {
+                analysis.indirectJumps.push_back(address);
+            }
+
+            break;
+        }
+    }
+
+
+    // 2. Cut the reachable code into basic blocks
+
+    for (unsigned int start = 0; start < 4096; ++start)
+    {
+        if (!leaders[start] || !analysis.instructionStart[start])
+        {
+            continue;
+        }
+
+        BasicBlock block;
+        block.start = static_cast<uint16_t>(start);
+
+        uint16_t address = block.start;
+
+        while (true)
+        {
+            uint16_t opcode = chip8.PeekOpcode(address);
+            Flow flow = Classify(opcode);
+            uint16_t next = NextAddress(address);
+
+            if (flow == Flow::Next)
+            {
+                if (leaders[next] || !analysis.instructionStart[next])
+                {
+                    block.exit = BasicBlock::Exit::Fallthrough;
+                    block.successors = { next };
+                    block.end = next;
+                    break;
+                }
+
+                address = next;
+                continue;
+            }
+
+            block.end = next;
+
+            switch (flow)
+            {
+                case Flow::Jump:
+                    block.exit = BasicBlock::Exit::Jump;
+                    block.successors = { static_cast<uint16_t>(opcode & 0x0FFFu) };
+                    break;
+                case Flow::Call:
+                    block.exit = BasicBlock::Exit::Call;
+                    block.successors = { static_cast<uint16_t>(opcode & 0x0FFFu), next };
+                    break;
+                case Flow::Skip:
+                    block.exit = BasicBlock::Exit::Skip;
+                    block.successors = { next, NextAddress(address, 2) };
+                    break;
+                case Flow::Return:
+                    block.exit = BasicBlock::Exit::Return;
+                    break;
+                default:
+                    block.exit = BasicBlock::Exit::Indirect;
+                    break;
+            }
+
+            break;
+        }
+
+        block.loopsToSelf = std::find(block.successors.begin(), block.successors.end(), block.start) != block.successors.end();
+
+        analysis.blocks.push_back(block);
+    }
+
+
+    // 3. Work out I at the start of every block (forward dataflow until nothing changes).
+    //    Reset leaves I at 0. A subroutine may change I, so nothing is known at a return site.
+
+    std::map<uint16_t, IndexState> entryIndex;
+
+    for (BasicBlock const& block : analysis.blocks)
+    {
+        entryIndex[block.start] = { IndexState::Unvisited, 0 };
+    }
+
+    entryIndex[entry] = { IndexState::Known, 0 };
+
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (BasicBlock const& block : analysis.blocks)
+        {
+            IndexState state = entryIndex[block.start];
+
+            if (state.kind == IndexState::Unvisited)
+            {
+                continue;
+            }
+
+            for (uint16_t address = block.start; address != block.end; address = NextAddress(address))
+            {
+                state = StepIndex(state, chip8.PeekOpcode(address));
+            }
+
+            for (size_t i = 0; i < block.successors.size(); ++i)
+            {
+                bool returnSite = block.exit == BasicBlock::Exit::Call && i == 1;
+                IndexState incoming = returnSite ? IndexState{ IndexState::Unknown, 0 } : state;
+
+                IndexState& target = entryIndex[block.successors[i]];
+                IndexState merged = IndexState::Meet(target, incoming);
+
+                if (!(merged == target))
+                {
+                    target = merged;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+
+    // 4. Flag writes through I that may land on code
+
+    for (BasicBlock const& block : analysis.blocks)
+    {
+        IndexState state = entryIndex[block.start];
+
+        for (uint16_t address = block.start; address != block.end; address = NextAddress(address))
+        {
+            uint16_t opcode = chip8.PeekOpcode(address);
+            unsigned int length = WriteLength(opcode);
+
+            if (length > 0)
+            {
+                if (state.kind != IndexState::Known)
+                {
+                    analysis.unresolvedWrites.push_back(address);
+                }
+                else
+                {
+                    for (unsigned int i = 0; i < length; ++i)
+                    {
+                        if (analysis.code[(state.value + i) & Chip8::MEMORY_MASK])
+                        {
+                            analysis.codeWrites.push_back(address);
+                            break;
+                        }
+                    }
+                }
+            }
+
+            state = StepIndex(state, opcode);
+        }
+    }
+
+    return analysis;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Chip8.h"
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+
+// Straight-line run of instructions with one entry (the first) and one exit (the last)
+struct BasicBlock
+{
+    enum class Exit : uint8_t
+    {
+        Fallthrough,    // Runs into the next block
+        Jump,           // 1nnn
+        Call,           // 2nnn, successors are the subroutine and the return site
+        Return,         // 00EE, no static successors
+        Skip,           // 3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1, successors are the next and the skipped-to instruction
+        Indirect        // Bnnn, target depends on V0
+    };
+
+    uint16_t start;                     // Address of the first instruction
+    uint16_t end;                       // Address just past the last instruction
+    Exit exit;
+    std::vector<uint16_t> successors;   // Start addresses of the blocks control can go to
+    bool loopsToSelf;                   // One of the successors is this block (busy/idle loop candidate)
+};
+
+
+// What a static pass over a loaded ROM found, used to pick fast paths before running it
+struct RomAnalysis
+{
+    std::vector<BasicBlock> blocks;     // Sorted by start address
+
+    std::bitset<4096> code;             // Bytes that belong to a reachable instruction
+    std::bitset<4096> instructionStart; // Addresses where a reachable instruction begins
+
+    std::vector<uint16_t> codeWrites;        // Fx33/Fx55 whose target range is known and overlaps code
+    std::vector<uint16_t> unresolvedWrites;  // Fx33/Fx55 where I can't be worked out statically
+    std::vector<uint16_t> indirectJumps;     // Bnnn, code reachable only through these was not explored
+
+    // Block containing the instruction at address, nullptr if that address isn't reachable code
+    BasicBlock const* FindBlock(uint16_t address) const;
+
+    // True when the ROM has to run on the self-modification-safe path (anything predecoded may go stale)
+    bool MayModifyCode() const
+    {
+        return !codeWrites.empty() || !unresolvedWrites.empty();
+    }
+};
+
+
+// Walks the code reachable from the entry point through jumps, calls and skips, decoding every opcode with
+// Chip8::Decode so the analysis agrees with what Cycle() would run. Nothing is executed.
+class RomAnalyzer
+{
+public:
+    static RomAnalysis Analyze(Chip8 const& chip8, uint16_t entry = Chip8::START_ADDRESS);
+};
@@ -0,0 +1,105 @@
+#include "RomDatabase.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+
+static bool HashLess(RomProfile const& a, RomProfile const& b)
+{
+    return a.hash < b.hash;
+}
+
+
+bool RomDatabase::Load(char const* filename)
+{
+    std::ifstream file(filename);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        RomProfile profile;
+        unsigned long cycles;
+
+        fields >> std::hex >> profile.hash >> std::dec >> cycles;
+
+        if (fields.fail() || cycles == 0 || cycles > std::numeric_limits<uint16_t>::max())
+        {
+            continue;
+        }
+
+        profile.cyclesPerFrame = static_cast<uint16_t>(cycles);
+
+        profiles.push_back(profile);
+    }
+
+    // Sort once here instead of on every Add, later entries win for duplicate hashes
+    std::stable_sort(profiles.begin(), profiles.end(), HashLess);
+
+    auto last = std::unique(profiles.rbegin(), profiles.rend(),
+        [](RomProfile const& a, RomProfile const& b) { return a.hash == b.hash; });
+    profiles.erase(profiles.begin(), last.base());
+
+    profiles.shrink_to_fit();
+
+    return true;
+}
+
+
+void RomDatabase::Add(RomProfile const& profile)
+{
+    auto it = std::lower_bound(profiles.begin(), profiles.end(), profile, HashLess);
+
+    if (it != profiles.end() && it->hash == profile.hash)
+    {
+        *it = profile;
+    }
+    else
+    {
+        profiles.insert(it, profile);
+    }
+}
+
+
+RomProfile RomDatabase::Find(uint64_t hash) const
+{
+    RomProfile key;
+    key.hash = hash;
+
+    auto it = std::lower_bound(profiles.begin(), profiles.end(), key, HashLess);
+
+    return (it != profiles.end() && it->hash == hash) ? *it : key;
+}
+
+
+size_t RomDatabase::Size() const
+{
+    return profiles.size();
+}
+
+
+uint64_t RomDatabase::Hash(uint8_t const* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Per-ROM settings, looked up by a hash of the ROM contents
+struct RomProfile
+{
+    // Instructions per 60 Hz frame when a ROM has no profile (~700 Hz)
+    const static uint16_t DEFAULT_CYCLES_PER_FRAME = 12;
+
+    uint64_t hash = 0;
+    uint16_t cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME;    // Lowest speed the game still plays correctly at
+};
+
+
+// Local database of tuned ROM profiles. Loaded once at startup into a sorted array (16 bytes per ROM),
+// lookups are a binary search on the content hash.
+//
+// The file is plain text, one ROM per line, anything after the second field is a free-form name (main prints
+// the hash of the ROM it loads):
+//
+//     # hash             cycles  name
+//     9f8c5e6d41a2b730   15      Pong
+class RomDatabase
+{
+public:
+    // Adds the profiles in the file, returns false if it can't be opened. Malformed lines, and cycle counts
+    // outside 1..65535, are skipped.
+    bool Load(char const* filename);
+
+    void Add(RomProfile const& profile);
+
+    // Profile for the ROM with this hash, or the defaults (with hash filled in) if there isn't one
+    RomProfile Find(uint64_t hash) const;
+
+    size_t Size() const;
+
+    // 64-bit FNV-1a of the ROM bytes
+    static uint64_t Hash(uint8_t const* data, size_t size);
+
+private:
+    std::vector<RomProfile> profiles;   // Sorted by hash
+};
@@ -0,0 +1,55 @@
+#include "RunAhead.h"
+#include <chrono>
+
+
+typedef std::chrono::steady_clock Clock;
+
+
+static double MicrosBetween(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+
+
+RunAhead::RunAhead(unsigned int frames) : frames(frames)
+{
+}
+
+
+uint32_t const* RunAhead::RunFrame(Chip8& chip8)
+{
+    auto start = Clock::now();
+
+    chip8.RunFrame();
+
+    if (frames == 0)
+    {
+        stats = { 0, MicrosBetween(start, Clock::now()), 0.0, 0.0 };
+        return chip8.video;
+    }
+
+    auto emulated = Clock::now();
+
+    // Snapshot: the machine is plain data, so a copy is all of it
+    speculative = chip8;
+
+    auto copied = Clock::now();
+
+    for (unsigned int i = 0; i < frames; ++i)
+    {
+        speculative.RunFrame();
+    }
+
+    auto end = Clock::now();
+
+    stats = { frames, MicrosBetween(start, emulated), MicrosBetween(emulated, copied), MicrosBetween(copied, end) };
+
+    return speculative.video;
+}
+
+
+RunAheadStats const& RunAhead::LastFrameStats() const
+{
+    return stats;
+}
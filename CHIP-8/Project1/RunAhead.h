@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Chip8.h"
+#include <cstdint>
+
+
+// Timings of the last frame, in microseconds
+struct RunAheadStats
+{
+    unsigned int framesAhead;   // How many frames earlier input shows up on screen
+    double emulateMicros;       // The real frame
+    double snapshotMicros;      // Copying the machine
+    double speculateMicros;     // The frames run ahead
+};
+
+
+// Hides input lag by presenting a frame from the future: after each real frame the machine is copied,
+// the copy runs `frames` more frames with the keys currently held, and its screen is shown instead.
+// The real machine never runs speculative frames, so nothing has to be rolled back.
+class RunAhead
+{
+public:
+    explicit RunAhead(unsigned int frames);
+
+    // Runs one real frame of chip8 and returns the video to present
+    uint32_t const* RunFrame(Chip8& chip8);
+
+    RunAheadStats const& LastFrameStats() const;
+
+private:
+    unsigned int frames;
+    Chip8 speculative;      // Scratch machine, overwritten every frame
+    RunAheadStats stats{};
+};
@@ -0,0 +1,358 @@
+#include "SessionScheduler.h"
+
+
+// One 60 Hz frame
+static const std::chrono::nanoseconds FRAME_PERIOD(1000000000 / 60);
+
+
+
+SessionScheduler::SessionScheduler(unsigned int workerCount)
+{
+    workerCount = (workerCount > 0) ? workerCount : 1;
+
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(&SessionScheduler::Worker, this);
+    }
+}
+
+
+SessionScheduler::~SessionScheduler()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    // Every session is suspended now, nothing else can touch them
+    for (auto& entry : sessions)
+    {
+        entry.second->handle.destroy();
+    }
+}
+
+
+SessionScheduler::SessionId SessionScheduler::Add(Chip8* chip8)
+{
+    std::unique_ptr<Session> session(new Session());
+    session->chip8 = chip8;
+    session->handle = Drive(*session).handle;
+
+    SessionId id;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        id = nextId++;
+        session->id = id;
+        session->nextFrame = Clock::now();
+
+        ready.push_back(session.get());
+        sessions[id] = std::move(session);
+    }
+
+    wake.notify_one();
+
+    return id;
+}
+
+
+void SessionScheduler::Remove(SessionId id)
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    auto it = sessions.find(id);
+
+    if (it == sessions.end())
+    {
+        return;
+    }
+
+    Session& session = *it->second;
+    session.removed.store(true, std::memory_order_relaxed);
+
+    // A parked session would only notice at its next frame (or never, on a key), run it now so it can finish.
+    // A running one is parked straight back into the ready queue by its worker (see Park).
+    if (session.state == State::WaitingKey || session.state == State::WaitingFrame)
+    {
+        session.state = State::Ready;
+        ready.push_back(&session);
+        wake.notify_one();
+    }
+
+    // The worker that runs it last erases it, until then it may still be inside chip8.Run()
+    erased.wait(guard, [&] { return sessions.find(id) == sessions.end(); });
+}
+
+
+void SessionScheduler::SetKeys(SessionId id, uint16_t keys)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = sessions.find(id);
+
+    if (it == sessions.end())
+    {
+        return;
+    }
+
+    Session& session = *it->second;
+    session.keys.store(keys, std::memory_order_relaxed);
+
+    if (keys != 0 && session.state == State::WaitingKey)
+    {
+        session.state = State::Ready;
+        ready.push_back(&session);
+        wake.notify_one();
+    }
+}
+
+
+SessionStats SessionScheduler::Stats(SessionId id) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = sessions.find(id);
+
+    if (it == sessions.end())
+    {
+        return SessionStats{};
+    }
+
+    Session const& session = *it->second;
+
+    return
+    {
+        session.frames.load(std::memory_order_relaxed),
+        session.cpuNanos.load(std::memory_order_relaxed),
+        session.keyWaits.load(std::memory_order_relaxed),
+        session.delayWaits.load(std::memory_order_relaxed),
+        session.framesSkipped.load(std::memory_order_relaxed)
+    };
+}
+
+
+size_t SessionScheduler::Count() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return sessions.size();
+}
+
+
+
+// Queues a session that has just suspended for whatever it is waiting on. Called with the lock held by the
+// worker that resumed it; that worker goes on to handle the queues itself, so nobody needs waking.
+void SessionScheduler::Park(Session& session)
+{
+    // Remove is waiting for it to finish
+    if (session.removed.load(std::memory_order_relaxed))
+    {
+        session.state = State::Ready;
+        ready.push_back(&session);
+        return;
+    }
+
+    if (session.parkOn == State::WaitingFrame)
+    {
+        Clock::time_point now = Clock::now();
+
+        // Stay on the 60 Hz grid, but don't try to catch up after falling more than a frame behind
+        session.nextFrame += FRAME_PERIOD * (1 + session.skipFrames);
+
+        if (session.nextFrame + FRAME_PERIOD < now)
+        {
+            session.nextFrame = now;
+        }
+
+        session.state = State::WaitingFrame;
+        timers.push({ session.nextFrame, session.id });
+        return;
+    }
+
+    // SetKeys may have run since the coroutine checked (it only queues sessions already parked on a key)
+    if (session.keys.load(std::memory_order_relaxed) != 0)
+    {
+        session.state = State::Ready;
+        ready.push_back(&session);
+        return;
+    }
+
+    session.state = State::WaitingKey;
+}
+
+
+
+SessionScheduler::FrameTask SessionScheduler::Drive(Session& session)
+{
+    Chip8& chip8 = *session.chip8;
+
+    while (!session.removed.load(std::memory_order_relaxed))
+    {
+        // The machine only ever sees new keys between frames
+        uint16_t keys = session.keys.load(std::memory_order_relaxed);
+
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            chip8.keypad[i] = (keys >> i) & 0x1u;
+        }
+
+        Clock::time_point start = Clock::now();
+
+        chip8.RunFrame();
+
+        session.cpuNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count(), std::memory_order_relaxed);
+        session.frames.fetch_add(1, std::memory_order_relaxed);
+
+        unsigned int idleFrames = DelayWaitFrames(chip8);
+
+        if (WaitingForKey(chip8))
+        {
+            session.keyWaits.fetch_add(1, std::memory_order_relaxed);
+            co_await KeyPress{ session };
+        }
+        else if (idleFrames > 0)
+        {
+            // Until the timer runs out the frames would only count it down, so skip them and do just that
+            session.delayWaits.fetch_add(1, std::memory_order_relaxed);
+            session.framesSkipped.fetch_add(idleFrames, std::memory_order_relaxed);
+            co_await NextFrame{ session, idleFrames };
+
+            for (unsigned int i = 0; i < idleFrames; ++i)
+            {
+                chip8.TickTimers();
+            }
+        }
+        else
+        {
+            co_await NextFrame{ session, 0 };
+        }
+    }
+}
+
+
+void SessionScheduler::Worker()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (!stopping)
+    {
+        Clock::time_point now = Clock::now();
+
+        while (!timers.empty() && timers.top().deadline <= now)
+        {
+            SessionId id = timers.top().id;
+            timers.pop();
+
+            // Gone or already woken by Remove
+            auto it = sessions.find(id);
+
+            if (it == sessions.end() || it->second->state != State::WaitingFrame)
+            {
+                continue;
+            }
+
+            it->second->state = State::Ready;
+            ready.push_back(it->second.get());
+        }
+
+        if (!ready.empty())
+        {
+            Session* session = ready.front();
+            ready.pop_front();
+            session->state = State::Running;
+
+            guard.unlock();
+            session->handle.resume();
+            guard.lock();
+
+            // Still only this worker's until it is parked again
+            if (session->handle.done())
+            {
+                session->handle.destroy();
+                sessions.erase(session->id);
+                erased.notify_all();
+            }
+            else
+            {
+                Park(*session);
+            }
+
+            continue;
+        }
+
+        if (timers.empty())
+        {
+            wake.wait(guard);
+        }
+        else
+        {
+            // wait_until keeps looking at the time point after relocking, by then other workers may have
+            // reallocated the heap under a reference into it
+            Clock::time_point deadline = timers.top().deadline;
+            wake.wait_until(guard, deadline);
+        }
+    }
+}
+
+
+// Stuck on LD Vx, K (Fx0A re-executes itself until a key is held)
+bool SessionScheduler::WaitingForKey(Chip8 const& chip8)
+{
+    if ((chip8.PeekOpcode(chip8.pc) & 0xF0FFu) != 0xF00Au)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        if (chip8.keypad[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Frames left (the delay timer) while spinning in LD Vx, DT / SE Vx, 0 / JP back, 0 if not in such a loop.
+// Vx ends up holding an earlier reading when the frames are skipped, the loop reads the timer again anyway.
+unsigned int SessionScheduler::DelayWaitFrames(Chip8 const& chip8)
+{
+    if (chip8.delayTimer == 0)
+    {
+        return 0;
+    }
+
+    // pc may be on any of the three instructions at the end of a frame
+    for (unsigned int offset = 0; offset <= 4; offset += 2)
+    {
+        uint16_t start = (chip8.pc - offset) & Chip8::MEMORY_MASK;
+        uint16_t load = chip8.PeekOpcode(start);
+        unsigned int x = (load & 0x0F00u) >> 8u;
+
+        if ((load & 0xF0FFu) != 0xF007u ||
+            chip8.PeekOpcode(start + 2u) != (0x3000u | (x << 8u)) ||
+            chip8.PeekOpcode(start + 4u) != (0x1000u | start))
+        {
+            continue;
+        }
+
+        // About to test a zero reading, the loop is leaving this frame
+        if (offset == 2 && chip8.registers[x] == 0)
+        {
+            return 0;
+        }
+
+        return chip8.delayTimer;
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Chip8.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+// CPU accounting for one session
+struct SessionStats
+{
+    uint64_t frames;        // Frames emulated
+    uint64_t cpuNanos;      // Time spent emulating them
+    uint64_t keyWaits;      // Times the session parked on Fx0A
+    uint64_t delayWaits;    // Times it parked until the delay timer ran out
+    uint64_t framesSkipped; // Frames not emulated while parked on the delay timer
+};
+
+
+// Runs many machines on a few worker threads. Each session is a coroutine that emulates one frame and then
+// yields, so sessions are interleaved frame by frame in FIFO order (round robin). Between frames a session is
+// parked until its next 60 Hz deadline. Idle machines cost nothing:
+//
+//   - blocked on Fx0A with no key held, a session is parked until SetKeys() gives it one (timers don't
+//     advance meanwhile)
+//   - spinning on the delay timer (LD Vx, DT / SE Vx, 0 / JP back), it is parked until the frame the timer
+//     reaches 0, and the timers are then counted down by the frames it skipped
+class SessionScheduler
+{
+public:
+    typedef uint32_t SessionId;
+
+    explicit SessionScheduler(unsigned int workerCount = std::thread::hardware_concurrency());
+    ~SessionScheduler();
+
+    SessionScheduler(SessionScheduler const&) = delete;
+    SessionScheduler& operator=(SessionScheduler const&) = delete;
+
+    // chip8 (with its ROM loaded) must stay alive until Remove() returns or the scheduler is destroyed
+    SessionId Add(Chip8* chip8);
+
+    // Blocks until the session has stopped (a frame already running is finished first) and is gone, after
+    // which its Chip8 can be freed. Must not be called from inside a session.
+    void Remove(SessionId id);
+
+    // Keys held in the session, bit n for key n. Picked up at the next frame boundary.
+    void SetKeys(SessionId id, uint16_t keys);
+
+    SessionStats Stats(SessionId id) const;
+    size_t Count() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class State
+    {
+        Ready,
+        Running,
+        WaitingFrame,
+        WaitingKey
+    };
+
+    struct Session
+    {
+        SessionId id;
+        Chip8* chip8;
+        std::coroutine_handle<> handle;
+
+        std::atomic<uint16_t> keys{ 0 };
+        std::atomic<bool> removed{ false };
+
+        std::atomic<uint64_t> frames{ 0 };
+        std::atomic<uint64_t> cpuNanos{ 0 };
+        std::atomic<uint64_t> keyWaits{ 0 };
+        std::atomic<uint64_t> delayWaits{ 0 };
+        std::atomic<uint64_t> framesSkipped{ 0 };
+
+        // Guarded by the scheduler lock
+        State state = State::Ready;
+        Clock::time_point nextFrame;
+
+        // What the coroutine suspended for (WaitingFrame or WaitingKey), and how many frames to leave out
+        // before the next one. Only touched by the worker running it.
+        State parkOn = State::WaitingFrame;
+        unsigned int skipFrames = 0;
+    };
+
+    struct Timer
+    {
+        Clock::time_point deadline;
+        SessionId id;           // Looked up again when the timer fires, Remove may have woken the session early
+
+        bool operator>(Timer const& other) const
+        {
+            return deadline > other.deadline;
+        }
+    };
+
+    // Coroutine type of Drive(), starts suspended and is resumed by the workers
+    struct FrameTask
+    {
+        struct promise_type
+        {
+            FrameTask get_return_object()
+            {
+                return { std::coroutine_handle<promise_type>::from_promise(*this) };
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    // co_await'ed at the end of a frame, the worker parks the session until its next frame deadline.
+    // The awaiters only say what the session waits for: it is queued again by the worker once resume() has
+    // returned, so no other worker can pick it up while this one still holds it.
+    struct NextFrame
+    {
+        Session& session;
+        unsigned int skipFrames;
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<>) const noexcept
+        {
+            session.parkOn = State::WaitingFrame;
+            session.skipFrames = skipFrames;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    // co_await'ed when the machine is stuck on Fx0A, the worker parks the session until a key is held
+    struct KeyPress
+    {
+        Session& session;
+
+        bool await_ready() const noexcept { return session.keys.load(std::memory_order_relaxed) != 0; }
+        void await_suspend(std::coroutine_handle<>) const noexcept { session.parkOn = State::WaitingKey; }
+        void await_resume() const noexcept {}
+    };
+
+    FrameTask Drive(Session& session);
+    void Worker();
+    void Park(Session& session);
+
+    static bool WaitingForKey(Chip8 const& chip8);
+    static unsigned int DelayWaitFrames(Chip8 const& chip8);
+
+    mutable std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable erased;         // A session was destroyed, for Remove()
+    std::deque<Session*> ready;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    std::unordered_map<SessionId, std::unique_ptr<Session>> sessions;
+    std::vector<std::thread> workers;
+    SessionId nextId = 1;
+    bool stopping = false;
+};
@@ -0,0 +1,252 @@
+#include "SharedFrameChannel.h"
+#include <new>
+#include <string.h>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+SharedFrameChannel::SharedFrameChannel(char const* name, bool create)
+{
+    strncpy(this->name, name, sizeof(this->name) - 1);
+
+    void* view = nullptr;
+
+#ifdef _WIN32
+    if (create)
+    {
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(Layout), name);
+
+        // Handed back an existing mapping, which may be another emulator's live block
+        if (mapping != nullptr && GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            nameInUse = true;
+        }
+    }
+    else
+    {
+        mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    }
+
+    if (mapping != nullptr)
+    {
+        view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Layout));
+    }
+#else
+    // Exclusive, so a second emulator can't reset a live block under its frontends or unlink the first one's name
+    int fd = shm_open(name, create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+
+    if (fd < 0 && create && errno == EEXIST)
+    {
+        nameInUse = true;
+    }
+
+    if (fd >= 0)
+    {
+        owner = create;
+
+        // A frontend can get in between the emulator's shm_open and ftruncate, and touching a mapping past the
+        // end of a still empty object is a SIGBUS
+        struct stat info;
+        bool sized = create ? ftruncate(fd, sizeof(Layout)) == 0 :
+            fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(Layout);
+
+        if (sized)
+        {
+            view = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            view = (view == MAP_FAILED) ? nullptr : view;
+        }
+
+        // The mapping keeps the memory alive
+        close(fd);
+    }
+#endif
+
+    if (view == nullptr)
+    {
+        return;
+    }
+
+    if (create)
+    {
+        shared = new (view) Layout();
+        shared->version = VERSION;
+        shared->sequence.store(0, std::memory_order_relaxed);
+        shared->keys.store(0, std::memory_order_relaxed);
+        shared->publishedAt.store(0, std::memory_order_relaxed);
+
+        for (std::atomic<uint64_t>& row : shared->rows)
+        {
+            row.store(0, std::memory_order_relaxed);
+        }
+
+        // Written last so a frontend that attaches early doesn't accept a half set up block
+        shared->magic.store(MAGIC, std::memory_order_release);
+    }
+    else
+    {
+        shared = static_cast<Layout*>(view);
+
+        if (shared->magic.load(std::memory_order_acquire) != MAGIC || shared->version != VERSION)
+        {
+            // Someone else's block, or a different build of the emulator
+#ifdef _WIN32
+            UnmapViewOfFile(view);
+#else
+            munmap(view, sizeof(Layout));
+#endif
+            shared = nullptr;
+        }
+    }
+}
+
+
+SharedFrameChannel::~SharedFrameChannel()
+{
+#ifdef _WIN32
+    if (shared != nullptr)
+    {
+        UnmapViewOfFile(shared);
+    }
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+#else
+    if (shared != nullptr)
+    {
+        munmap(shared, sizeof(Layout));
+    }
+    if (owner)
+    {
+        shm_unlink(name);
+    }
+#endif
+}
+
+
+bool SharedFrameChannel::IsOpen() const
+{
+    return shared != nullptr;
+}
+
+
+bool SharedFrameChannel::NameInUse() const
+{
+    return nameInUse;
+}
+
+
+
+void SharedFrameChannel::PublishFrame(Chip8 const& chip8)
+{
+    PublishFrame(chip8.video);
+}
+
+
+void SharedFrameChannel::PublishFrame(uint32_t const* video)
+{
+    uint32_t sequence = shared->sequence.load(std::memory_order_relaxed);
+
+    // Odd: readers will retry until the frame is complete
+    shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+    {
+        shared->rows[y].store(PackedFrame::PackRow(&video[y * Chip8::VIDEO_WIDTH]), std::memory_order_relaxed);
+    }
+
+    shared->publishedAt.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    shared->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+void SharedFrameChannel::ReadKeys(uint8_t* keypad) const
+{
+    uint32_t keys = shared->keys.load(std::memory_order_relaxed);
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        keypad[i] = (keys >> i) & 0x1u;
+    }
+}
+
+
+
+uint32_t SharedFrameChannel::TryReadFrame(PackedFrame& frame, uint32_t lastSequence, Clock::time_point* publishedAt) const
+{
+    while (true)
+    {
+        uint32_t before = shared->sequence.load(std::memory_order_acquire);
+
+        if (before == lastSequence)
+        {
+            return lastSequence;
+        }
+
+        if (before & 0x1u)
+        {
+            // Frame being written right now, it takes well under a microsecond
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (unsigned int y = 0; y < Chip8::VIDEO_HEIGHT; ++y)
+        {
+            frame.rows[y] = shared->rows[y].load(std::memory_order_relaxed);
+        }
+
+        int64_t ticks = shared->publishedAt.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (shared->sequence.load(std::memory_order_relaxed) == before)
+        {
+            if (publishedAt != nullptr)
+            {
+                *publishedAt = Clock::time_point(Clock::duration(ticks));
+            }
+
+            return before;
+        }
+    }
+}
+
+
+uint32_t SharedFrameChannel::WaitForFrame(PackedFrame& frame, uint32_t lastSequence, Clock::duration timeout,
+    Clock::time_point* publishedAt) const
+{
+    auto giveUp = Clock::now() + timeout;
+    uint32_t sequence;
+
+    while ((sequence = TryReadFrame(frame, lastSequence, publishedAt)) == lastSequence && Clock::now() < giveUp)
+    {
+        std::this_thread::yield();
+    }
+
+    return sequence;
+}
+
+
+void SharedFrameChannel::WriteKeys(uint8_t const* keypad)
+{
+    uint32_t keys = 0;
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        keys |= (keypad[i] ? 1u : 0u) << i;
+    }
+
+    shared->keys.store(keys, std::memory_order_relaxed);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Chip8.h"
+#include "PackedFrame.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+
+// Named shared-memory block that carries frames from the emulator process to any number of frontend
+// processes, and keypad state back. Frames are published with a seqlock (the sequence is odd while a
+// frame is being written), so the producer never waits and readers retry on the rare torn read.
+//
+// POSIX shared memory (shm_open) on Linux/macOS, a named file mapping on Windows. Names should look
+// like "/chip8-session-1".
+//
+// Each frame carries the steady_clock time it was published at (system wide on both platforms), so a
+// frontend can measure the handoff.
+class SharedFrameChannel
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // create = true for the emulator side (makes and owns the block), false for a frontend attaching to it.
+    // Creating fails if the name already exists, see NameInUse.
+    SharedFrameChannel(char const* name, bool create);
+    ~SharedFrameChannel();
+
+    SharedFrameChannel(SharedFrameChannel const&) = delete;
+    SharedFrameChannel& operator=(SharedFrameChannel const&) = delete;
+
+    bool IsOpen() const;
+
+    // Creating failed because the name exists: another emulator is publishing on it, or on POSIX one exited
+    // without unlinking it (shm_unlink, or delete it from /dev/shm on Linux). There is no telling a live block
+    // from a stale one, so it is never taken over.
+    bool NameInUse() const;
+
+
+    // ------- EMULATOR SIDE --------
+
+    // Packs video straight into shared memory and bumps the frame sequence
+    void PublishFrame(Chip8 const& chip8);
+    void PublishFrame(uint32_t const* video);       // VIDEO_WIDTH * VIDEO_HEIGHT pixels, e.g. a run-ahead frame
+
+    // Copies the keypad state last written by a frontend into keypad[16]
+    void ReadKeys(uint8_t* keypad) const;
+
+
+    // ------- FRONTEND SIDE --------
+
+    // Copies the latest frame if it is newer than lastSequence, returns its sequence (or lastSequence if nothing new).
+    // publishedAt, if given, gets the time the frame was published.
+    uint32_t TryReadFrame(PackedFrame& frame, uint32_t lastSequence, Clock::time_point* publishedAt = nullptr) const;
+
+    // Spins until a frame newer than lastSequence is published or timeout runs out (then returns lastSequence)
+    uint32_t WaitForFrame(PackedFrame& frame, uint32_t lastSequence, Clock::duration timeout,
+        Clock::time_point* publishedAt = nullptr) const;
+
+    void WriteKeys(uint8_t const* keypad);
+
+
+private:
+    struct Layout
+    {
+        std::atomic<uint32_t> magic;                        // Stored last by the emulator, once the rest is set up
+        uint32_t version;
+        std::atomic<uint32_t> sequence;                     // Even when the frame is stable, odd while it's written
+        std::atomic<uint32_t> keys;                         // Bit n set while key n is held
+        std::atomic<int64_t> publishedAt;                   // Clock ticks since its epoch, part of the frame
+        std::atomic<uint64_t> rows[Chip8::VIDEO_HEIGHT];
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free &&
+        std::atomic<int64_t>::is_always_lock_free,
+        "shared-memory atomics must be lock free to work across processes");
+
+    const static uint32_t MAGIC = 0x43384652u;      // "C8FR"
+    const static uint32_t VERSION = 2;
+
+    Layout* shared = nullptr;
+    bool owner = false;                             // Created the name, so unlinks it
+    bool nameInUse = false;
+    char name[64]{};
+
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+};
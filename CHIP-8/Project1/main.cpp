@@ -0,0 +1,261 @@
+#include "Chip8.h"
+#include "FramePacer.h"
+#include "FrameRecorder.h"
+#include "FusionPlan.h"
+#include "Platform.h"
+#include "RomAnalyzer.h"
+#include "RomDatabase.h"
+#include "RunAhead.h"
+#include "SharedFrameChannel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+
+// Shows the frames an emulator process publishes on channelName and sends it this window's keys
+static int RunFrontend(int videoScale, char const* channelName)
+{
+    typedef SharedFrameChannel::Clock Clock;
+
+    SharedFrameChannel channel(channelName, false);
+
+    if (!channel.IsOpen())
+    {
+        std::cerr << "No emulator is publishing on " << channelName << "\n";
+        return EXIT_FAILURE;
+    }
+
+    Platform platform("CHIP-8 Frontend", Chip8::VIDEO_WIDTH * videoScale, Chip8::VIDEO_HEIGHT * videoScale, Chip8::VIDEO_WIDTH, Chip8::VIDEO_HEIGHT);
+
+    // The emulator's pacer already decides when frames come out, present each one as soon as it arrives
+    platform.SetVSync(0);
+
+    static uint32_t video[Chip8::VIDEO_WIDTH * Chip8::VIDEO_HEIGHT];
+    int videoPitch = sizeof(video[0]) * Chip8::VIDEO_WIDTH;
+
+    uint8_t keys[16]{};
+    PackedFrame frame{};
+    uint32_t sequence = 0;
+
+    // Publish to received, in microseconds
+    static double handoffs[FramePacer::STATS_WINDOW];
+    unsigned int handoffCount = 0;
+
+    bool quit = false;
+
+    while (!quit)
+    {
+        quit = platform.ProcessInput(keys);
+        channel.WriteKeys(keys);
+
+        // Spins for the next frame, coming back now and then to keep the window responsive if the emulator stalls
+        Clock::time_point publishedAt;
+        uint32_t latest = channel.WaitForFrame(frame, sequence, std::chrono::milliseconds(20), &publishedAt);
+
+        if (latest == sequence)
+        {
+            continue;
+        }
+
+        handoffs[handoffCount++] = std::chrono::duration<double, std::micro>(Clock::now() - publishedAt).count();
+        sequence = latest;
+
+        frame.Unpack(video);
+        platform.Update(video, videoPitch);
+
+        if (handoffCount == FramePacer::STATS_WINDOW)
+        {
+            std::sort(handoffs, handoffs + handoffCount);
+
+            std::cerr << "handoff: p50 " << handoffs[handoffCount / 2] << " us p99 " << handoffs[handoffCount * 99 / 100]
+                << " us max " << handoffs[handoffCount - 1] << " us\n";
+
+            handoffCount = 0;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc == 4 && std::string(argv[2]) == "--attach")
+    {
+        return RunFrontend(std::stoi(argv[1]), argv[3]);
+    }
+
+    if (argc < 3 || argc > 7)
+    {
+        std::cerr << "Usage: " << argv[0] << " <Scale> <ROM> [<RomDatabase> | -] [<RunAheadFrames>] [<CaptureFile> | -] [<ChannelName>]\n"
+            << "       " << argv[0] << " <Scale> --attach <ChannelName>\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    int videoScale = std::stoi(argv[1]);
+    char const* romFilename = argv[2];
+    bool useRomDatabase = argc >= 4 && std::string(argv[3]) != "-";
+    unsigned int runAheadFrames = (argc >= 5) ? std::stoi(argv[4]) : 0;
+    char const* captureFilename = (argc >= 6 && std::string(argv[5]) != "-") ? argv[5] : nullptr;
+    char const* channelName = (argc == 7) ? argv[6] : nullptr;
+
+    // Profiles are read once at startup, LoadROM picks the one matching the ROM's hash
+    static RomDatabase romDatabase;
+
+    if (useRomDatabase && !romDatabase.Load(argv[3]))
+    {
+        std::cerr << "Could not open ROM database " << argv[3] << ", using default settings\n";
+    }
+
+    Chip8::UseRomDatabase(&romDatabase);
+
+    Platform platform("CHIP-8 Emulator", Chip8::VIDEO_WIDTH * videoScale, Chip8::VIDEO_HEIGHT * videoScale, Chip8::VIDEO_WIDTH, Chip8::VIDEO_HEIGHT);
+
+    static Chip8 chip8;
+    chip8.LoadROM(romFilename);
+
+    // The hash is what a RomDatabase line starts with
+    std::cerr << "ROM " << romFilename << ": hash " << std::hex << std::setw(16) << std::setfill('0') << chip8.profile.hash
+        << std::dec << std::setfill(' ') << ", " << chip8.profile.cyclesPerFrame << " instructions per frame\n";
+
+    // Fused sequences, only if the ROM is shown not to rewrite its own code
+    static FusionPlan fusionPlan;
+
+    if (fusionPlan.Build(chip8, RomAnalyzer::Analyze(chip8)))
+    {
+        chip8.SetFusion(&fusionPlan);
+    }
+
+    int videoPitch = sizeof(chip8.video[0]) * Chip8::VIDEO_WIDTH;
+
+    // Records what the real machine shows (not the run-ahead frames), a few KB a minute
+    std::unique_ptr<FrameRecorder> recorder;
+
+    if (captureFilename != nullptr)
+    {
+        recorder = std::make_unique<FrameRecorder>(captureFilename);
+
+        if (!recorder->IsOpen())
+        {
+            std::cerr << "Could not create capture file " << captureFilename << "\n";
+            recorder.reset();
+        }
+    }
+
+    // Frontends in other processes (main --attach) see every presented frame and can hold keys
+    std::unique_ptr<SharedFrameChannel> channel;
+
+    if (channelName != nullptr)
+    {
+        channel = std::make_unique<SharedFrameChannel>(channelName, true);
+
+        if (channel->NameInUse())
+        {
+            std::cerr << "Frame channel " << channelName << " is already in use by another emulator, or was left "
+                "behind by one that crashed (remove it with shm_unlink, or from /dev/shm on Linux)\n";
+            channel.reset();
+        }
+        else if (!channel->IsOpen())
+        {
+            std::cerr << "Could not create frame channel " << channelName << "\n";
+            channel.reset();
+        }
+    }
+
+    // Shows the screen a few frames ahead of the real machine to cut input lag (0 = off)
+    static RunAhead runAhead(runAheadFrames);
+    RunAheadStats statsTotal{};
+    unsigned int statsFrames = 0;
+
+    // One emulated frame per 60 Hz tick, running as many instructions as the ROM's profile asks for. Locked to
+    // vsync when the display runs at a multiple of 60 Hz, paced by the timer (with vsync still on if possible)
+    // when it doesn't.
+    static FramePacer pacer;
+    double refreshHz = platform.RefreshRate();
+    unsigned int vsyncInterval = FramePacer::LockedInterval(refreshHz);
+    bool locked = vsyncInterval > 0 && platform.SetVSync(vsyncInterval);
+
+    if (!locked)
+    {
+        platform.SetVSync(1);
+    }
+
+    pacer.SetDisplay(refreshHz, locked ? vsyncInterval : 0);
+
+    unsigned int pacerFrames = 0;
+    uint8_t localKeys[16]{};
+    uint8_t remoteKeys[16]{};
+    bool quit = false;
+
+    while (!quit)
+    {
+        quit = platform.ProcessInput(localKeys);
+
+        if (channel)
+        {
+            channel->ReadKeys(remoteKeys);
+        }
+
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            chip8.keypad[i] = localKeys[i] | remoteKeys[i];
+        }
+
+        uint32_t const* video = runAhead.RunFrame(chip8);
+
+        if (recorder)
+        {
+            recorder->Record(chip8);
+        }
+
+        pacer.WaitForPresent();
+        pacer.PresentStarted();
+        platform.Update(video, videoPitch);
+        pacer.PresentFinished();
+
+        if (channel)
+        {
+            channel->PublishFrame(video);
+        }
+
+        if (runAheadFrames > 0)
+        {
+            RunAheadStats const& stats = runAhead.LastFrameStats();
+
+            statsTotal.emulateMicros += stats.emulateMicros;
+            statsTotal.snapshotMicros += stats.snapshotMicros;
+            statsTotal.speculateMicros += stats.speculateMicros;
+
+            // Averages once a second, per frame numbers are too noisy to read
+            if (++statsFrames == 60)
+            {
+                std::cerr << "run-ahead: " << stats.framesAhead << " frames (" << stats.framesAhead * 1000 / 60 << " ms) less latency, per frame "
+                    << statsTotal.emulateMicros / statsFrames << " us emulate + "
+                    << statsTotal.snapshotMicros / statsFrames << " us snapshot + "
+                    << statsTotal.speculateMicros / statsFrames << " us run-ahead\n";
+
+                statsTotal = RunAheadStats{};
+                statsFrames = 0;
+            }
+        }
+
+        if (++pacerFrames == FramePacer::STATS_WINDOW)
+        {
+            FramePacerStats stats = pacer.Stats();
+
+            std::cerr << "pacing: " << stats.refreshHz << " Hz display, "
+                << (stats.vsyncInterval > 0 ? "vsync x" + std::to_string(stats.vsyncInterval) : std::string("timer")) << ", frame p50 "
+                << stats.frameP50Millis << " ms p99 " << stats.frameP99Millis << " ms, present p50 "
+                << stats.presentP50Millis << " ms p99 " << stats.presentP99Millis << " ms, sleep margin "
+                << stats.sleepMarginMillis << " ms, " << stats.missedDeadlines << "/" << stats.frames << " missed\n";
+
+            pacerFrames = 0;
+        }
+    }
+
+    return 0;
+}